@@ -0,0 +1,107 @@
+#include "alloc_stats.h"
+
+#ifdef PDF2TEXT_COUNT_ALLOCATIONS
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include "profiler.h"
+
+static std::atomic<uint64_t> stageAllocations[stageCount];
+static std::atomic<uint64_t> stageBytes[stageCount];
+
+// constant initialized, so operator new may use it at any time of the thread's life
+static thread_local AllocationCount allocations;
+
+/***
+ * Count an allocation of the calling thread and its stage
+ * @param size requested bytes
+ */
+static void countAllocation(size_t size) {
+    allocations.allocations++;
+    allocations.bytes += size;
+
+    size_t stage = (size_t)currentThreadStage();
+    stageAllocations[stage].fetch_add(1, std::memory_order_relaxed);
+    stageBytes[stage].fetch_add(size, std::memory_order_relaxed);
+}
+
+void* operator new(size_t size) {
+    countAllocation(size);
+    void* pointer = std::malloc(size > 0 ? size : 1);
+    if(pointer == nullptr) {
+        throw std::bad_alloc();
+    }
+    return pointer;
+}
+
+void* operator new(size_t size, std::align_val_t alignment) {
+    countAllocation(size);
+    size_t align = std::max(sizeof(void*), (size_t)alignment);
+    void* pointer = nullptr;
+    if(posix_memalign(&pointer, align, size > 0 ? size : 1) != 0) {
+        throw std::bad_alloc();
+    }
+    return pointer;
+}
+
+// array and nothrow forms forward to these in libstdc++
+
+// gcc sees the malloc inside the replaced operator new and reports every matching free as a mismatch
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+
+void operator delete(void* pointer) noexcept {
+    std::free(pointer);
+}
+
+void operator delete(void* pointer, size_t) noexcept {
+    std::free(pointer);
+}
+
+void operator delete(void* pointer, std::align_val_t) noexcept {
+    std::free(pointer);
+}
+
+void operator delete(void* pointer, size_t, std::align_val_t) noexcept {
+    std::free(pointer);
+}
+
+AllocationCount threadAllocations() {
+    return allocations;
+}
+
+nlohmann::json allocationMetrics() {
+    nlohmann::json stages = nlohmann::json::object();
+    for(size_t s = 0; s < stageCount; s++) {
+        if(stageAllocations[s].load() > 0) {
+            stages[stageName((Stage)s)] = {
+                    {"allocations", stageAllocations[s].load()},
+                    {"bytes", stageBytes[s].load()}
+            };
+        }
+    }
+    return stages;
+}
+
+AllocationRegion::AllocationRegion(const char* name, bool mustNotAllocate)
+        : name(name), mustNotAllocate(mustNotAllocate), start(allocations) {
+}
+
+AllocationRegion::~AllocationRegion() {
+    AllocationCount counted = count();
+    if(mustNotAllocate && counted.allocations > 0) {
+        std::fprintf(stderr, "%s allocated %llu times, %llu bytes\n", name, (unsigned long long)counted.allocations,
+                     (unsigned long long)counted.bytes);
+        std::abort();
+    }
+}
+
+AllocationCount AllocationRegion::count() const {
+    return {allocations.allocations - start.allocations, allocations.bytes - start.bytes};
+}
+
+#endif
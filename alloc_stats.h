@@ -0,0 +1,82 @@
+#ifndef PDF2TEXT_ALLOC_STATS_H
+#define PDF2TEXT_ALLOC_STATS_H
+
+#include <cstdint>
+#include "include/nlohmann/json.hpp"
+
+/***
+ * Heap allocations counted by the instrumented operator new
+ */
+struct AllocationCount {
+    uint64_t allocations = 0;
+    uint64_t bytes = 0;
+};
+
+#ifdef PDF2TEXT_COUNT_ALLOCATIONS
+
+/***
+ * Get the allocations of the calling thread since it started
+ * @return allocation count and requested bytes
+ */
+AllocationCount threadAllocations();
+
+/***
+ * Get the allocations by pipeline stage for the metrics report
+ * @return allocations and bytes by stage as JSON object
+ */
+nlohmann::json allocationMetrics();
+
+/***
+ * Region counting the heap allocations of the calling thread, a region that must not allocate aborts with its name
+ * when it did, so allocation-free hot paths cannot silently regress
+ */
+class AllocationRegion {
+public:
+    /***
+     * Start counting
+     * @param name region name printed when the region allocated
+     * @param mustNotAllocate true to abort if the region allocates
+     */
+    explicit AllocationRegion(const char* name, bool mustNotAllocate = true);
+    ~AllocationRegion();
+
+    AllocationRegion(const AllocationRegion&) = delete;
+    AllocationRegion& operator=(const AllocationRegion&) = delete;
+
+    /***
+     * Get the allocations since the region started
+     * @return allocation count and requested bytes
+     */
+    AllocationCount count() const;
+
+private:
+    const char* name;
+    bool mustNotAllocate;
+    AllocationCount start;
+};
+
+#else
+
+// without instrumentation regions compile to nothing and count no allocations
+
+inline AllocationCount threadAllocations() {
+    return {};
+}
+
+inline nlohmann::json allocationMetrics() {
+    return nullptr;
+}
+
+class AllocationRegion {
+public:
+    explicit AllocationRegion(const char*, bool = true) {
+    }
+
+    AllocationCount count() const {
+        return {};
+    }
+};
+
+#endif
+
+#endif //PDF2TEXT_ALLOC_STATS_H
@@ -0,0 +1,476 @@
+#include "archive.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <fcntl.h>
+#include <filesystem>
+#include <unistd.h>
+#include <zlib.h>
+
+/***
+ * Check if a string ends with the given suffix
+ * @param text string to check
+ * @param suffix expected ending
+ * @return true if text ends with suffix
+ */
+static bool endsWith(const std::string& text, const std::string& suffix) {
+    return text.size() >= suffix.size() && text.compare(text.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+bool isArchive(const std::string& path) {
+    return endsWith(path, ".tar") || endsWith(path, ".tar.gz") || endsWith(path, ".tgz") || endsWith(path, ".zip");
+}
+
+/***
+ * Read exactly size bytes from a (possibly compressed) stream
+ * @param in zlib stream, plain files are read transparently
+ * @param buffer target buffer
+ * @param size number of bytes to read
+ * @return number of bytes read, less than size at end of stream
+ */
+static size_t readFully(gzFile in, char* buffer, size_t size) {
+    size_t done = 0;
+
+    while(done < size) {
+        unsigned int chunk = (unsigned int)std::min<size_t>(size - done, 1u << 30);
+        int count = gzread(in, buffer + done, chunk);
+
+        if(count <= 0) {
+            break;
+        }
+        done += count;
+    }
+    return done;
+}
+
+/***
+ * Parse a numeric tar header field (octal or GNU base-256)
+ * @param field header field
+ * @param length field length
+ * @return field value
+ */
+static uint64_t tarNumber(const char* field, size_t length) {
+    uint64_t value = 0;
+
+    // base-256 encoding for members larger than 8 GiB
+    if((unsigned char)field[0] & 0x80) {
+        value = (unsigned char)field[0] & 0x7f;
+        for(size_t i = 1; i < length; i++) {
+            value = (value << 8) | (unsigned char)field[i];
+        }
+        return value;
+    }
+
+    for(size_t i = 0; i < length && field[i] != '\0'; i++) {
+        if(field[i] >= '0' && field[i] <= '7') {
+            value = (value << 3) | (field[i] - '0');
+        }
+    }
+    return value;
+}
+
+/***
+ * Read the "path" record of a pax extended header
+ * @param data pax header content
+ * @return member path or empty string
+ */
+static std::string paxPath(const std::vector<char>& data) {
+    size_t pos = 0;
+
+    // records have the form "<length> <key>=<value>\n"
+    while(pos < data.size()) {
+        size_t space = pos;
+        while(space < data.size() && data[space] != ' ') {
+            space++;
+        }
+
+        size_t length = std::strtoul(std::string(data.data() + pos, space - pos).c_str(), nullptr, 10);
+        if(length == 0 || pos + length > data.size()) {
+            break;
+        }
+
+        std::string record(data.data() + space + 1, pos + length - space - 2);
+        if(record.compare(0, 5, "path=") == 0) {
+            return record.substr(5);
+        }
+        pos += length;
+    }
+    return "";
+}
+
+/***
+ * Iterate over the members of a tar stream
+ * @param in zlib stream positioned at a tar header
+ * @param header first header block if it was already consumed, otherwise nullptr
+ * @param archiveSize size of a plain tar file, 0 if unknown or compressed
+ * @param handler callback for every regular file
+ * @return false if the stream ended inside a member
+ */
+static bool readTar(gzFile in, const char* header, uint64_t archiveSize, const ArchiveMemberHandler& handler) {
+    char block[512];
+    char padding[512];
+    std::string longName;
+    std::vector<char> data;
+
+    if(header != nullptr) {
+        std::memcpy(block, header, sizeof(block));
+    }
+    else if(readFully(in, block, sizeof(block)) != sizeof(block)) {
+        return false;
+    }
+
+    do {
+        // an empty block marks the end of the archive
+        if(block[0] == '\0') {
+            return true;
+        }
+
+        uint64_t size = tarNumber(block + 124, 12);
+        char type = block[156];
+
+        // a corrupt size field must not allocate more than the archive holds
+        if(archiveSize > 0 && size > archiveSize - std::min<uint64_t>(archiveSize, gztell(in))) {
+            return false;
+        }
+
+        // compressed streams have no known length, so the buffer grows with the bytes actually read
+        data.clear();
+        while(data.size() < size) {
+            size_t chunk = (size_t)std::min<uint64_t>(size - data.size(), 16u << 20);
+            data.resize(data.size() + chunk);
+            if(readFully(in, data.data() + data.size() - chunk, chunk) != chunk) {
+                return false;
+            }
+        }
+
+        // skip padding up to the next block
+        size_t paddingSize = (512 - size % 512) % 512;
+        if(readFully(in, padding, paddingSize) != paddingSize) {
+            return false;
+        }
+
+        if(type == 'L') {
+            // GNU long name for the next member
+            longName.assign(data.data(), strnlen(data.data(), data.size()));
+        }
+        else if(type == 'x') {
+            // pax extended header for the next member
+            longName = paxPath(data);
+        }
+        else if(type == '0' || type == '\0' || type == '7') {
+            std::string path;
+
+            if(!longName.empty()) {
+                path = longName;
+            }
+            else {
+                // ustar splits long names into prefix and name
+                std::string name(block, strnlen(block, 100));
+                std::string prefix(block + 345, strnlen(block + 345, 155));
+                path = prefix.empty() ? name : prefix + "/" + name;
+            }
+            longName.clear();
+
+            handler(path, data);
+        }
+        else {
+            longName.clear();
+        }
+    } while(readFully(in, block, sizeof(block)) == sizeof(block));
+
+    return true;
+}
+
+/***
+ * Random access reader for zip archives
+ * @param offset absolute position
+ * @param buffer target buffer
+ * @param size number of bytes to read
+ * @return true if all bytes were read
+ */
+using ZipReader = std::function<bool(uint64_t offset, char* buffer, size_t size)>;
+
+/***
+ * Read a little endian integer
+ * @param data source bytes
+ * @param bytes integer width
+ * @return integer value
+ */
+static uint64_t littleEndian(const char* data, int bytes) {
+    uint64_t value = 0;
+    for(int i = bytes - 1; i >= 0; i--) {
+        value = (value << 8) | (unsigned char)data[i];
+    }
+    return value;
+}
+
+/***
+ * Decompress a raw deflate stream
+ * @param input compressed data
+ * @param output buffer sized to the uncompressed member size
+ * @return true if the stream was complete
+ */
+static bool inflateMember(const std::vector<char>& input, std::vector<char>& output) {
+    z_stream stream{};
+    if(inflateInit2(&stream, -MAX_WBITS) != Z_OK) {
+        return false;
+    }
+
+    // zip64 members exceed the 32 bit counters of zlib, so both sides are passed in chunks
+    const size_t chunk = 1u << 30;
+    size_t consumed = 0;
+    size_t produced = 0;
+    int status = Z_OK;
+
+    while(status == Z_OK) {
+        if(stream.avail_in == 0 && consumed < input.size()) {
+            stream.next_in = (Bytef*)input.data() + consumed;
+            stream.avail_in = (uInt)std::min(input.size() - consumed, chunk);
+            consumed += stream.avail_in;
+        }
+        if(stream.avail_out == 0 && produced < output.size()) {
+            stream.next_out = (Bytef*)output.data() + produced;
+            stream.avail_out = (uInt)std::min(output.size() - produced, chunk);
+            produced += stream.avail_out;
+        }
+        status = inflate(&stream, consumed == input.size() && produced == output.size() ? Z_FINISH : Z_NO_FLUSH);
+    }
+    inflateEnd(&stream);
+
+    return status == Z_STREAM_END && stream.avail_out == 0 && produced == output.size();
+}
+
+/***
+ * Iterate over the members of a zip archive using its central directory
+ * @param read random access reader
+ * @param size archive size
+ * @param handler callback for every regular file
+ * @param skipped callback for members that cannot be read, may be empty
+ * @return false if the archive is malformed
+ */
+static bool readZip(const ZipReader& read, uint64_t size, const ArchiveMemberHandler& handler,
+                    const ArchiveSkipHandler& skipped) {
+    // locate the end of central directory record within the trailing comment window
+    size_t tailSize = (size_t)std::min<uint64_t>(size, 65557);
+    std::vector<char> tail(tailSize);
+    if(!read(size - tailSize, tail.data(), tailSize)) {
+        return false;
+    }
+
+    long eocd = -1;
+    for(long i = (long)tailSize - 22; i >= 0; i--) {
+        if(littleEndian(tail.data() + i, 4) == 0x06054b50) {
+            eocd = i;
+            break;
+        }
+    }
+    if(eocd < 0) {
+        return false;
+    }
+
+    uint64_t entries = littleEndian(tail.data() + eocd + 10, 2);
+    uint64_t directorySize = littleEndian(tail.data() + eocd + 12, 4);
+    uint64_t directoryOffset = littleEndian(tail.data() + eocd + 16, 4);
+
+    // zip64 archives store the real values in a separate record
+    if(eocd >= 20 && littleEndian(tail.data() + eocd - 20, 4) == 0x07064b50) {
+        char record[56];
+        if(!read(littleEndian(tail.data() + eocd - 12, 8), record, sizeof(record)) ||
+           littleEndian(record, 4) != 0x06064b50) {
+            return false;
+        }
+        entries = littleEndian(record + 32, 8);
+        directorySize = littleEndian(record + 40, 8);
+        directoryOffset = littleEndian(record + 48, 8);
+    }
+
+    // the central directory lies within the archive, each entry takes at least 46 bytes
+    if(directoryOffset > size || directorySize > size - directoryOffset || entries > directorySize / 46) {
+        return false;
+    }
+
+    std::vector<char> directory(directorySize);
+    if(!read(directoryOffset, directory.data(), directorySize)) {
+        return false;
+    }
+
+    std::vector<char> compressed;
+    std::vector<char> data;
+    size_t pos = 0;
+
+    auto skip = [&](const std::string& path, const std::string& reason) {
+        if(skipped) {
+            skipped(path, reason);
+        }
+    };
+
+    for(uint64_t entry = 0; entry < entries; entry++) {
+        if(pos + 46 > directory.size() || littleEndian(directory.data() + pos, 4) != 0x02014b50) {
+            return false;
+        }
+
+        const char* header = directory.data() + pos;
+        uint64_t method = littleEndian(header + 10, 2);
+        uint64_t compressedSize = littleEndian(header + 20, 4);
+        uint64_t uncompressedSize = littleEndian(header + 24, 4);
+        size_t nameLength = littleEndian(header + 28, 2);
+        size_t extraLength = littleEndian(header + 30, 2);
+        size_t commentLength = littleEndian(header + 32, 2);
+        uint64_t localOffset = littleEndian(header + 42, 4);
+
+        if(pos + 46 + nameLength + extraLength > directory.size()) {
+            return false;
+        }
+        std::string path(header + 46, nameLength);
+
+        // zip64 extra field replaces saturated 32 bit values in fixed order
+        const char* extra = header + 46 + nameLength;
+        for(size_t e = 0; e + 4 <= extraLength;) {
+            uint64_t id = littleEndian(extra + e, 2);
+            size_t length = littleEndian(extra + e + 2, 2);
+            const char* field = extra + e + 4;
+
+            if(id == 0x0001) {
+                if(uncompressedSize == 0xffffffff) { uncompressedSize = littleEndian(field, 8); field += 8; }
+                if(compressedSize == 0xffffffff) { compressedSize = littleEndian(field, 8); field += 8; }
+                if(localOffset == 0xffffffff) { localOffset = littleEndian(field, 8); }
+            }
+            e += 4 + length;
+        }
+
+        pos += 46 + nameLength + extraLength + commentLength;
+
+        // skip directories
+        if(path.empty() || path.back() == '/') {
+            continue;
+        }
+
+        if(method != 0 && method != 8) {
+            skip(path, "unsupported compression method");
+            continue;
+        }
+
+        // the central directory stays readable, so a corrupt member only costs itself
+        char local[30];
+        if(localOffset > size || !read(localOffset, local, sizeof(local)) || littleEndian(local, 4) != 0x04034b50) {
+            skip(path, "corrupt archive member");
+            continue;
+        }
+
+        // member data follows the local header with its own name and extra field lengths
+        uint64_t dataOffset = localOffset + 30 + littleEndian(local + 26, 2) + littleEndian(local + 28, 2);
+        if(dataOffset > size || compressedSize > size - dataOffset) {
+            skip(path, "corrupt archive member");
+            continue;
+        }
+
+        // deflate expands at most 1032:1, larger sizes are corrupt and must not be allocated
+        if(method == 0 ? uncompressedSize != compressedSize : uncompressedSize / 1032 > compressedSize) {
+            skip(path, "corrupt archive member size");
+            continue;
+        }
+
+        if(method == 0) {
+            data.resize(uncompressedSize);
+            if(!read(dataOffset, data.data(), uncompressedSize)) {
+                skip(path, "corrupt archive member");
+                continue;
+            }
+        }
+        else {
+            compressed.resize(compressedSize);
+            data.resize(uncompressedSize);
+            if(!read(dataOffset, compressed.data(), compressedSize) || !inflateMember(compressed, data)) {
+                skip(path, "corrupt archive member");
+                continue;
+            }
+        }
+
+        handler(path, data);
+    }
+    return true;
+}
+
+bool readArchive(const std::string& path, const ArchiveMemberHandler& handler, const ArchiveSkipHandler& skipped) {
+    if(endsWith(path, ".zip")) {
+        int fd = open(path.c_str(), O_RDONLY);
+        if(fd < 0) {
+            return false;
+        }
+
+        off_t size = lseek(fd, 0, SEEK_END);
+        ZipReader read = [fd](uint64_t offset, char* buffer, size_t length) {
+            size_t done = 0;
+            while(done < length) {
+                ssize_t count = pread(fd, buffer + done, length - done, (off_t)(offset + done));
+                if(count <= 0) {
+                    return false;
+                }
+                done += count;
+            }
+            return true;
+        };
+
+        bool result = size >= 0 && readZip(read, size, handler, skipped);
+        close(fd);
+        return result;
+    }
+
+    // gzip streams are decompressed transparently, plain tar files are read as they are
+    gzFile in = gzopen(path.c_str(), "rb");
+    if(in == nullptr) {
+        return false;
+    }
+    gzbuffer(in, 1 << 20);
+
+    // the size of a plain tar file bounds its members, compressed streams are bounded while reading
+    std::error_code error;
+    uint64_t archiveSize = std::filesystem::file_size(path, error);
+    bool result = readTar(in, nullptr, gzdirect(in) && !error ? archiveSize : 0, handler);
+    gzclose(in);
+    return result;
+}
+
+bool readStdin(const ArchiveMemberHandler& handler, const ArchiveSkipHandler& skipped) {
+    gzFile in = gzdopen(dup(STDIN_FILENO), "rb");
+    if(in == nullptr) {
+        return false;
+    }
+    gzbuffer(in, 1 << 20);
+
+    // the first block decides between a single PDF, a zip and a tar stream
+    char block[512];
+    size_t count = readFully(in, block, sizeof(block));
+    bool result = true;
+
+    if(count == sizeof(block) && std::memcmp(block, "%PDF", 4) != 0 && std::memcmp(block, "PK\x03\x04", 4) != 0) {
+        result = readTar(in, block, 0, handler);
+    }
+    else {
+        // PDFs and zip archives need random access, so read the full input
+        std::vector<char> data(block, block + count);
+        char buffer[1 << 16];
+        size_t chunk;
+        while((chunk = readFully(in, buffer, sizeof(buffer))) > 0) {
+            data.insert(data.end(), buffer, buffer + chunk);
+        }
+
+        if(data.size() >= 4 && std::memcmp(data.data(), "PK\x03\x04", 4) == 0) {
+            ZipReader read = [&data](uint64_t offset, char* target, size_t length) {
+                if(offset + length > data.size()) {
+                    return false;
+                }
+                std::memcpy(target, data.data() + offset, length);
+                return true;
+            };
+            result = readZip(read, data.size(), handler, skipped);
+        }
+        else {
+            handler("stdin", data);
+        }
+    }
+
+    gzclose(in);
+    return result;
+}
@@ -0,0 +1,47 @@
+#ifndef PDF2TEXT_ARCHIVE_H
+#define PDF2TEXT_ARCHIVE_H
+
+#include <functional>
+#include <string>
+#include <vector>
+
+/***
+ * Callback for every regular file found in an archive
+ * @param path member path inside the archive
+ * @param data member content
+ */
+using ArchiveMemberHandler = std::function<void(const std::string& path, std::vector<char>& data)>;
+
+/***
+ * Callback for a member that is left out because it cannot be read
+ * @param path member path inside the archive
+ * @param reason reason for skipping the member
+ */
+using ArchiveSkipHandler = std::function<void(const std::string& path, const std::string& reason)>;
+
+/***
+ * Check if a path names a supported archive (tar, tar.gz, tgz, zip)
+ * @param path file path
+ * @return true if the file is read as an archive
+ */
+bool isArchive(const std::string& path);
+
+/***
+ * Read all members of a tar (optionally gzip compressed) or zip archive without extracting them to disk
+ * @param path archive path
+ * @param handler callback for every member
+ * @param skipped callback for corrupt zip members, nullptr to leave them out silently
+ * @return false if the archive could not be read
+ */
+bool readArchive(const std::string& path, const ArchiveMemberHandler& handler,
+                 const ArchiveSkipHandler& skipped = nullptr);
+
+/***
+ * Read a single PDF, a tar (optionally gzip compressed) or a zip archive from standard input
+ * @param handler callback for every member, a single PDF is reported as member "stdin"
+ * @param skipped callback for corrupt zip members, nullptr to leave them out silently
+ * @return false if the input could not be read
+ */
+bool readStdin(const ArchiveMemberHandler& handler, const ArchiveSkipHandler& skipped = nullptr);
+
+#endif //PDF2TEXT_ARCHIVE_H
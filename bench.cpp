@@ -0,0 +1,306 @@
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <boost/program_options.hpp>
+#include <fcntl.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include "include/nlohmann/json.hpp"
+#include "synthetic.h"
+
+/***
+ * Resources used by the processes of one benchmark run
+ */
+struct RunUsage {
+    double seconds = 0;
+    double cpuSeconds = 0;
+    // peak resident set of the largest process
+    long maxRssKiB = 0;
+    bool failed = false;
+};
+
+/***
+ * Start PDF2Text processes in a working directory and wait for all of them
+ * @param dir working directory of the processes
+ * @param commands argument lists, one per process
+ * @return wall time and resource usage
+ */
+static RunUsage runProcesses(const std::string& dir, const std::vector<std::vector<std::string>>& commands) {
+    RunUsage usage;
+    std::vector<pid_t> pids;
+    auto start = std::chrono::steady_clock::now();
+
+    for(size_t i = 0; i < commands.size(); i++) {
+        pid_t pid = fork();
+        if(pid == 0) {
+            // keep the console clean, the tool logs titles of skipped files
+            if(chdir(dir.c_str()) != 0) {
+                _exit(127);
+            }
+            int log = open(("stdout-" + std::to_string(i) + ".log").c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+            if(log >= 0) {
+                dup2(log, STDOUT_FILENO);
+                close(log);
+            }
+
+            std::vector<char*> argv;
+            for(const std::string& argument: commands[i]) {
+                argv.push_back(const_cast<char*>(argument.c_str()));
+            }
+            argv.push_back(nullptr);
+            execv(argv[0], argv.data());
+            _exit(127);
+        }
+        if(pid < 0) {
+            usage.failed = true;
+            continue;
+        }
+        pids.push_back(pid);
+    }
+
+    for(pid_t pid: pids) {
+        int status;
+        struct rusage resources{};
+        wait4(pid, &status, 0, &resources);
+
+        usage.failed |= !WIFEXITED(status) || WEXITSTATUS(status) != 0;
+        usage.cpuSeconds += (double)resources.ru_utime.tv_sec + (double)resources.ru_utime.tv_usec / 1e6 +
+                            (double)resources.ru_stime.tv_sec + (double)resources.ru_stime.tv_usec / 1e6;
+        usage.maxRssKiB = std::max(usage.maxRssKiB, resources.ru_maxrss);
+    }
+
+    usage.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return usage;
+}
+
+/***
+ * Sum the sizes of all output files of a run
+ * @param dir working directory of the run
+ * @return bytes of JSON and SQLite output
+ */
+static uint64_t outputBytes(const std::string& dir) {
+    uint64_t bytes = 0;
+    std::error_code error;
+    for(auto& entry: std::filesystem::recursive_directory_iterator(dir, error)) {
+        std::string name = entry.path().filename().string();
+        if(entry.is_regular_file() && (name.rfind("output", 0) == 0)) {
+            bytes += entry.file_size(error);
+        }
+    }
+    return bytes;
+}
+
+/***
+ * Add up the lock contention counters of all metrics files of a run
+ * @param dir working directory of the run
+ * @return counters by mutex name
+ */
+static nlohmann::json lockCounters(const std::string& dir) {
+    nlohmann::json locks = nlohmann::json::object();
+    std::error_code error;
+
+    for(auto& entry: std::filesystem::directory_iterator(dir, error)) {
+        if(entry.path().filename().string().rfind("metrics", 0) != 0) {
+            continue;
+        }
+
+        std::ifstream in(entry.path());
+        nlohmann::json metrics = nlohmann::json::parse(in, nullptr, false);
+        if(metrics.is_discarded() || !metrics.contains("locks")) {
+            continue;
+        }
+
+        for(auto& lock: metrics["locks"].items()) {
+            if(!locks.contains(lock.key())) {
+                locks[lock.key()] = {{"acquisitions", 0}, {"contended", 0}, {"wait_ms", 0.0}};
+            }
+            nlohmann::json& total = locks[lock.key()];
+            for(const char* counter: {"acquisitions", "contended"}) {
+                total[counter] = total[counter].get<uint64_t>() + lock.value()[counter].get<uint64_t>();
+            }
+            total["wait_ms"] = total["wait_ms"].get<double>() + lock.value()["wait_ms"].get<double>();
+        }
+    }
+    return locks;
+}
+
+/***
+ * run the synthetic corpus through PDF2Text at 1, 2, 4 ... N threads and report how each mode scales
+ * @param argc list of arguments
+ * @param argv options
+ * @return program exit code
+ */
+int main(int argc, char* argv[]) {
+    namespace po = boost::program_options;
+
+    std::error_code error;
+    std::string own = std::filesystem::read_symlink("/proc/self/exe", error).parent_path().string();
+
+    po::options_description visible("Options");
+    visible.add_options()
+            ("help,h", "print this help")
+            ("binary", po::value<std::string>()->default_value(own + "/PDF2Text"), "PDF2Text executable")
+            ("corpus", po::value<std::string>()->default_value("bench-corpus"),
+             "corpus directory, generated if it holds no PDF")
+            ("documents", po::value<int>()->default_value(64), "generated documents")
+            ("pages", po::value<int>()->default_value(40), "pages per generated document")
+            ("sections", po::value<int>()->default_value(12), "ToC sections per generated document")
+            ("threads", po::value<size_t>()->default_value(std::max(1u, std::thread::hardware_concurrency())),
+             "highest thread count")
+            ("modes", po::value<std::string>()->default_value("files,sqlite,queue"),
+             "files: worker pool, sqlite: workers feeding the single sqlite writer, queue: one process per thread")
+            ("output", po::value<std::string>()->default_value("bench"), "report prefix, writes .json and .csv")
+            ("language", po::value<std::string>()->default_value("en"), "language tag passed to PDF2Text");
+
+    po::variables_map options;
+    try {
+        po::store(po::parse_command_line(argc, argv, visible), options);
+    }
+    catch(const po::error& error) {
+        std::cout << error.what() << std::endl;
+        return 1;
+    }
+
+    if(options.count("help")) {
+        std::cout << "Usage: PDF2TextBench [options]" << std::endl << visible << std::endl;
+        return 0;
+    }
+
+    std::string binary = std::filesystem::absolute(options["binary"].as<std::string>()).string();
+    std::string corpus = std::filesystem::absolute(options["corpus"].as<std::string>()).string();
+    std::string language = options["language"].as<std::string>();
+
+    // generate the corpus once, later runs reuse it
+    std::filesystem::create_directories(corpus, error);
+    uint64_t corpusBytes = 0;
+    size_t documents = 0;
+    for(auto& entry: std::filesystem::directory_iterator(corpus, error)) {
+        if(entry.path().extension() == ".pdf") {
+            corpusBytes += entry.file_size(error);
+            documents++;
+        }
+    }
+
+    if(documents == 0) {
+        for(int d = 0; d < options["documents"].as<int>(); d++) {
+            SyntheticDocument shape;
+            // vary the sizes so the scheduler has short and long jobs
+            shape.pages = std::max(1, options["pages"].as<int>() * (1 + d % 4) / 2);
+            shape.sections = options["sections"].as<int>();
+            shape.seed = d + 1;
+
+            std::string pdf = syntheticPdf(shape);
+            std::ofstream out(corpus + "/synthetic-" + std::to_string(d) + ".pdf", std::ofstream::binary);
+            out.write(pdf.data(), (std::streamsize)pdf.size());
+            corpusBytes += pdf.size();
+            documents++;
+        }
+    }
+
+    std::vector<size_t> threadCounts;
+    size_t maxThreads = std::max<size_t>(1, options["threads"].as<size_t>());
+    for(size_t t = 1; t < maxThreads; t *= 2) {
+        threadCounts.push_back(t);
+    }
+    threadCounts.push_back(maxThreads);
+
+    std::vector<std::string> modes;
+    std::stringstream modeList(options["modes"].as<std::string>());
+    for(std::string mode; std::getline(modeList, mode, ',');) {
+        if(mode != "files" && mode != "sqlite" && mode != "queue") {
+            std::cout << "Please enter files, sqlite or queue as modes" << std::endl;
+            return 1;
+        }
+        modes.push_back(mode);
+    }
+
+    nlohmann::json runs = nlohmann::json::array();
+    std::ofstream csv(options["output"].as<std::string>() + ".csv", std::ofstream::trunc);
+    csv << "mode,threads,seconds,documents_per_second,mib_per_second,speedup,efficiency,cpu_utilization,"
+           "max_rss_mib,bandwidth_mib_per_second,contended_locks,lock_wait_ms" << std::endl;
+
+    for(const std::string& mode: modes) {
+        double baseline = 0;
+
+        for(size_t threads: threadCounts) {
+            std::string dir = std::filesystem::absolute("bench-runs/" + mode + "-" + std::to_string(threads)).string();
+            std::filesystem::remove_all(dir, error);
+            std::filesystem::create_directories(dir, error);
+
+            std::vector<std::vector<std::string>> commands;
+            if(mode == "queue") {
+                for(size_t p = 0; p < threads; p++) {
+                    commands.push_back({binary, "--queue", dir + "/queue", "-j", "1", "--metrics",
+                                        "metrics-" + std::to_string(p) + ".json", language, corpus});
+                }
+            }
+            else {
+                commands.push_back({binary, "-j", std::to_string(threads), "--metrics", "metrics.json"});
+                if(mode == "sqlite") {
+                    commands.back().insert(commands.back().end(), {"--format", "sqlite"});
+                }
+                commands.back().insert(commands.back().end(), {language, corpus});
+            }
+
+            RunUsage usage = runProcesses(dir, commands);
+            uint64_t written = outputBytes(dir);
+            nlohmann::json locks = lockCounters(dir);
+
+            uint64_t contended = 0;
+            double waitMs = 0;
+            for(auto& lock: locks.items()) {
+                contended += lock.value().value("contended", (uint64_t)0);
+                waitMs += lock.value().value("wait_ms", 0.0);
+            }
+
+            if(threads == threadCounts.front()) {
+                baseline = usage.seconds;
+            }
+            double speedup = usage.seconds > 0 ? baseline / usage.seconds : 0;
+
+            // every input byte is parsed and every output byte is built and written at least once
+            double bandwidth = (double)(corpusBytes + 2 * written) / (1 << 20) / usage.seconds;
+
+            nlohmann::json run{
+                    {"mode", mode},
+                    {"threads", threads},
+                    {"failed", usage.failed},
+                    {"seconds", usage.seconds},
+                    {"documents_per_second", (double)documents / usage.seconds},
+                    {"mib_per_second", (double)corpusBytes / (1 << 20) / usage.seconds},
+                    {"speedup", speedup},
+                    {"efficiency", speedup / (double)threads * (double)threadCounts.front()},
+                    {"cpu_utilization", usage.cpuSeconds / usage.seconds},
+                    {"max_rss_mib", (double)usage.maxRssKiB / 1024},
+                    {"output_bytes", written},
+                    {"bandwidth_mib_per_second", bandwidth},
+                    {"locks", locks}
+            };
+            runs.push_back(run);
+
+            csv << mode << "," << threads << "," << usage.seconds << "," << run["documents_per_second"] << ","
+                << run["mib_per_second"] << "," << speedup << "," << run["efficiency"] << ","
+                << run["cpu_utilization"] << "," << run["max_rss_mib"] << "," << bandwidth << "," << contended << ","
+                << waitMs << std::endl;
+            std::cout << mode << " x" << threads << ": " << usage.seconds << " s, speedup " << speedup
+                      << (usage.failed ? " (failed)" : "") << std::endl;
+        }
+    }
+
+    nlohmann::json report{
+            {"corpus", {{"path", corpus}, {"documents", documents}, {"bytes", corpusBytes}}},
+            {"hardware_threads", std::thread::hardware_concurrency()},
+            {"runs", runs}
+    };
+    std::ofstream out(options["output"].as<std::string>() + ".json", std::ofstream::trunc);
+    out << report.dump(2) << std::endl;
+
+    return 0;
+}
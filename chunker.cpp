@@ -0,0 +1,93 @@
+#include "chunker.h"
+
+#include <algorithm>
+
+/***
+ * Move a position back to the start of a UTF-8 character
+ * @param text text
+ * @param pos byte position
+ * @param min lowest allowed position
+ * @return position of a lead byte or the end of the text
+ */
+static size_t characterStart(std::string_view text, size_t pos, size_t min) {
+    while(pos > min && pos < text.size() && ((unsigned char)text[pos] & 0xc0) == 0x80) {
+        pos--;
+    }
+    return pos;
+}
+
+/***
+ * Find the best end of a chunk within its size budget
+ * @param text text
+ * @param start start of the chunk
+ * @param limit end of the size budget
+ * @return end of the chunk
+ */
+static size_t chunkEnd(std::string_view text, size_t start, size_t limit) {
+    // boundaries in the first half of the budget would make too small chunks
+    size_t min = start + (limit - start) / 2;
+    std::string_view window = text.substr(min, limit - min);
+
+    size_t paragraph = window.rfind('\n');
+    if(paragraph != std::string_view::npos) {
+        return min + paragraph + 1;
+    }
+
+    for(size_t i = window.size(); i > 1; i--) {
+        char c = window[i - 2];
+        if(window[i - 1] == ' ' && (c == '.' || c == '!' || c == '?')) {
+            return min + i;
+        }
+    }
+
+    size_t word = window.rfind(' ');
+    if(word != std::string_view::npos) {
+        return min + word + 1;
+    }
+
+    size_t end = characterStart(text, limit, start + 1);
+
+    // a budget smaller than the character at the start ends the chunk after that character instead of inside it
+    while(end < text.size() && ((unsigned char)text[end] & 0xc0) == 0x80) {
+        end++;
+    }
+    return end;
+}
+
+std::vector<Chunk> chunkText(std::string_view text, size_t size, size_t overlap) {
+    std::vector<Chunk> chunks;
+    size = std::max<size_t>(size, 1);
+    overlap = std::min(overlap, size / 2);
+
+    for(size_t start = 0; start < text.size();) {
+        size_t end = text.size() - start <= size ? text.size() : chunkEnd(text, start, start + size);
+
+        // chunks do not start or end with separators
+        size_t first = start, last = end;
+        while(first < last && (text[first] == ' ' || text[first] == '\n')) {
+            first++;
+        }
+        while(last > first && (text[last - 1] == ' ' || text[last - 1] == '\n')) {
+            last--;
+        }
+        if(last > first) {
+            chunks.push_back({first, last - first});
+        }
+
+        if(end == text.size()) {
+            break;
+        }
+
+        // the next chunk repeats the last words of this one
+        size_t next = std::max(start + 1, end - std::min(overlap, end));
+        if(next < end) {
+            size_t word = text.substr(next, end - next).find(' ');
+            next = word != std::string_view::npos ? next + word + 1 : end;
+        }
+        start = std::max(next, start + 1);
+        while(start < text.size() && ((unsigned char)text[start] & 0xc0) == 0x80) {
+            start++;
+        }
+    }
+    return chunks;
+}
@@ -0,0 +1,25 @@
+#ifndef PDF2TEXT_CHUNKER_H
+#define PDF2TEXT_CHUNKER_H
+
+#include <string_view>
+#include <vector>
+
+/***
+ * Size-bounded piece of a section text
+ */
+struct Chunk {
+    // byte offset in the section text
+    size_t offset;
+    size_t length;
+};
+
+/***
+ * Split a text into chunks of at most size bytes, preferring paragraph, then sentence, then word boundaries
+ * @param text section text, paragraphs separated by '\n'
+ * @param size maximum chunk size in bytes
+ * @param overlap bytes repeated from the end of the previous chunk, rounded to a word boundary
+ * @return chunks in text order
+ */
+std::vector<Chunk> chunkText(std::string_view text, size_t size, size_t overlap);
+
+#endif //PDF2TEXT_CHUNKER_H
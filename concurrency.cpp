@@ -0,0 +1,309 @@
+#include "concurrency.h"
+
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <sched.h>
+#include <sstream>
+#include <unistd.h>
+
+/***
+ * Read the first line of a file
+ * @param path file path
+ * @param line first line
+ * @return false if the file could not be read
+ */
+static bool readLine(const std::string& path, std::string& line) {
+    std::ifstream in(path);
+    return (bool)std::getline(in, line);
+}
+
+/***
+ * Parse an unsigned number at the start of a text
+ * @param text text such as a line of a cgroup file
+ * @param value parsed number
+ * @return false if the text does not start with a number
+ */
+static bool parseNumber(const std::string& text, uint64_t& value) {
+    auto result = std::from_chars(text.data(), text.data() + text.size(), value);
+    return result.ec == std::errc();
+}
+
+/***
+ * Parse a decimal number at the start of a text, with strtod where from_chars lacks floating point support
+ * @param text text such as a line of a cgroup file
+ * @param value parsed number
+ * @return false if the text does not start with a number
+ */
+static bool parseNumber(const std::string& text, double& value) {
+#if defined(__cpp_lib_to_chars)
+    auto result = std::from_chars(text.data(), text.data() + text.size(), value);
+    return result.ec == std::errc();
+#else
+    char* end = nullptr;
+    value = std::strtod(text.c_str(), &end);
+    return end != text.c_str() && std::isfinite(value);
+#endif
+}
+
+/***
+ * Get all directories from a cgroup up to the mount root, limits of parents apply as well
+ * @param mount cgroup mount point
+ * @param path cgroup path from /proc/self/cgroup
+ * @return candidate directories
+ */
+static std::vector<std::string> cgroupDirectories(const std::string& mount, std::string path) {
+    std::vector<std::string> dirs;
+
+    while(!path.empty() && path != "/") {
+        dirs.push_back(mount + path);
+        path = path.substr(0, path.find_last_of('/'));
+    }
+    dirs.push_back(mount);
+    return dirs;
+}
+
+ResourceLimits detectLimits() {
+    ResourceLimits limits;
+
+    // CPUs in the affinity mask, this covers cpusets
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    if(sched_getaffinity(0, sizeof(set), &set) == 0) {
+        limits.cpus = CPU_COUNT(&set);
+    }
+    else {
+        limits.cpus = std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    std::ifstream cgroups("/proc/self/cgroup");
+    std::string line;
+
+    while(std::getline(cgroups, line)) {
+        // lines have the form "<id>:<controllers>:<path>"
+        size_t first = line.find(':');
+        size_t second = line.find(':', first + 1);
+        if(first == std::string::npos || second == std::string::npos) {
+            continue;
+        }
+        std::string controllers = line.substr(first + 1, second - first - 1);
+        std::string path = line.substr(second + 1);
+        std::string value;
+
+        if(controllers.empty()) {
+            // cgroup v2 unified hierarchy
+            for(const std::string& dir: cgroupDirectories("/sys/fs/cgroup", path)) {
+                if(readLine(dir + "/cpu.max", value)) {
+                    std::istringstream fields(value);
+                    std::string quota;
+                    double period = 0;
+                    double cpus = 0;
+                    fields >> quota >> period;
+
+                    if(quota != "max" && period > 0 && parseNumber(quota, cpus) && cpus > 0) {
+                        limits.cpus = std::min(limits.cpus, cpus / period);
+                    }
+                }
+                uint64_t memory = 0;
+                if(readLine(dir + "/memory.max", value) && value != "max" && parseNumber(value, memory)) {
+                    limits.memory = limits.memory == 0 ? memory : std::min(limits.memory, memory);
+                }
+            }
+        }
+        else if(controllers.find("cpu") != std::string::npos && controllers.find("cpuset") == std::string::npos) {
+            // cgroup v1 CFS quota, -1 if unlimited
+            for(const std::string& dir: cgroupDirectories("/sys/fs/cgroup/" + controllers, path)) {
+                std::string period;
+                double quota = 0, length = 0;
+                if(readLine(dir + "/cpu.cfs_quota_us", value) && readLine(dir + "/cpu.cfs_period_us", period) &&
+                   parseNumber(value, quota) && parseNumber(period, length) && quota > 0 && length > 0) {
+                    limits.cpus = std::min(limits.cpus, quota / length);
+                }
+            }
+        }
+        else if(controllers == "memory") {
+            // cgroup v1 reports unlimited memory as a huge number
+            for(const std::string& dir: cgroupDirectories("/sys/fs/cgroup/memory", path)) {
+                uint64_t memory = 0;
+                if(readLine(dir + "/memory.limit_in_bytes", value) && parseNumber(value, memory) &&
+                   memory < (1ull << 60)) {
+                    limits.memory = limits.memory == 0 ? memory : std::min(limits.memory, memory);
+                }
+            }
+        }
+    }
+
+    return limits;
+}
+
+/***
+ * Get the cgroup v2 directory of this process
+ * @return directory under /sys/fs/cgroup, empty without a unified hierarchy
+ */
+static std::string unifiedCgroup() {
+    std::ifstream cgroups("/proc/self/cgroup");
+    std::string line;
+
+    while(std::getline(cgroups, line)) {
+        // the unified hierarchy is the line "0::<path>"
+        if(line.compare(0, 3, "0::") == 0) {
+            std::string path = line.substr(3);
+            return "/sys/fs/cgroup" + (path == "/" ? "" : path);
+        }
+    }
+    return "";
+}
+
+/***
+ * Get the share of time tasks stalled on memory during the last 10 seconds
+ * @return PSI "some avg10" in percent of this process's cgroup or else the system, 0 if unavailable
+ */
+static double memoryPressure() {
+    static const std::string cgroup = unifiedCgroup();
+    std::string line;
+
+    if((cgroup.empty() || !readLine(cgroup + "/memory.pressure", line)) &&
+       !readLine("/proc/pressure/memory", line)) {
+        return 0;
+    }
+
+    size_t pos = line.find("avg10=");
+    double pressure = 0;
+    return pos != std::string::npos && parseNumber(line.substr(pos + 6), pressure) ? pressure : 0;
+}
+
+/***
+ * Get the resident set size of this process
+ * @return RSS in bytes
+ */
+static uint64_t residentMemory() {
+    std::ifstream statm("/proc/self/statm");
+    uint64_t size = 0, resident = 0;
+    statm >> size >> resident;
+    return resident * (uint64_t)sysconf(_SC_PAGESIZE);
+}
+
+ConcurrencyController::ConcurrencyController(size_t maxWorkers, bool adaptive, uint64_t memoryLimit)
+        : maxWorkers(std::max<size_t>(maxWorkers, 1)), adaptive(adaptive), memoryLimit(memoryLimit),
+          limit(std::max<size_t>(maxWorkers, 1)), start(std::chrono::steady_clock::now()) {
+    if(adaptive && this->maxWorkers > 1) {
+        controller = std::thread(&ConcurrencyController::control, this);
+    }
+}
+
+ConcurrencyController::~ConcurrencyController() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    changed.notify_all();
+
+    if(controller.joinable()) {
+        controller.join();
+    }
+}
+
+void ConcurrencyController::acquire() {
+    std::unique_lock<std::mutex> lock(mutex);
+    changed.wait(lock, [&]() { return active < limit; });
+    active++;
+}
+
+void ConcurrencyController::release(size_t pageCount, bool finished) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        active--;
+        pages += pageCount;
+        documents += finished;
+    }
+    changed.notify_all();
+}
+
+size_t ConcurrencyController::share() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return std::max<size_t>(1, limit / std::max<size_t>(1, active));
+}
+
+void ConcurrencyController::control() {
+    const auto interval = std::chrono::seconds(2);
+
+    double lastRate = 0;
+    long direction = -1;
+    size_t lastPages = 0;
+    size_t lastDocuments = 0;
+    int hold = 0;
+
+    std::unique_lock<std::mutex> lock(mutex);
+
+    while(!changed.wait_for(lock, interval, [&]() { return stopping; })) {
+        double rate = (double)(pages - lastPages) / (double)interval.count();
+        bool finishedDocuments = documents > lastDocuments;
+        lastPages = pages;
+        lastDocuments = documents;
+
+        double pressure = memoryPressure();
+        uint64_t rss = residentMemory();
+        size_t previous = limit;
+
+        if(pressure > 10.0 || (memoryLimit > 0 && rss > memoryLimit / 10 * 9)) {
+            // stalls on memory or close to the OOM killer, halve concurrency and stop probing for a while
+            limit = std::max<size_t>(1, limit / 2);
+            direction = -1;
+            hold = 3;
+            backoffs++;
+        }
+        else if(hold > 0) {
+            hold--;
+        }
+        else if(!finishedDocuments) {
+            // no document finished, throughput is not measurable yet
+            continue;
+        }
+        else {
+            // keep moving while throughput improves, turn around when it drops
+            if(rate < lastRate * 0.95) {
+                direction = -direction;
+            }
+
+            // do not grow close to the memory limit
+            long step = direction;
+            if(step > 0 && memoryLimit > 0 && rss > memoryLimit / 10 * 8) {
+                step = 0;
+            }
+
+            limit = (size_t)std::clamp<long>((long)limit + step, 1, (long)maxWorkers);
+
+            // probe upwards again once the lower bound is reached
+            if(limit == 1 && direction < 0) {
+                direction = 1;
+            }
+        }
+        lastRate = rate;
+
+        if(limit != previous) {
+            double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            history.push_back({{"time", std::round(seconds * 10) / 10}, {"workers", limit},
+                               {"pages_per_second", rate}, {"memory_pressure", pressure}, {"rss", rss}});
+            changed.notify_all();
+        }
+    }
+}
+
+nlohmann::json ConcurrencyController::metrics() {
+    std::lock_guard<std::mutex> lock(mutex);
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    return {
+            {"max_workers", maxWorkers},
+            {"adaptive", adaptive},
+            {"final_workers", limit},
+            {"memory_backoffs", backoffs},
+            {"documents", documents},
+            {"pages", pages},
+            {"seconds", seconds},
+            {"pages_per_second", seconds > 0 ? (double)pages / seconds : 0.0},
+            {"history", history}
+    };
+}
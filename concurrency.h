@@ -0,0 +1,99 @@
+#ifndef PDF2TEXT_CONCURRENCY_H
+#define PDF2TEXT_CONCURRENCY_H
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "include/nlohmann/json.hpp"
+
+/***
+ * CPU and memory available to this process
+ */
+struct ResourceLimits {
+    // usable CPUs from the affinity mask and the cgroup CPU quota
+    double cpus = 1;
+    // cgroup memory limit in bytes, 0 if unlimited
+    uint64_t memory = 0;
+};
+
+/***
+ * Detect the CPU quota and memory limit of the cgroup (v1 or v2) and the CPU affinity mask
+ * @return resource limits of this process
+ */
+ResourceLimits detectLimits();
+
+/***
+ * Gate limiting the number of concurrently converted documents, adapted at runtime by hill-climbing on
+ * page throughput and backing off on memory pressure
+ */
+class ConcurrencyController {
+public:
+    /***
+     * Start the controller
+     * @param maxWorkers number of worker threads, never exceeded
+     * @param adaptive false to keep all workers active
+     * @param memoryLimit memory limit in bytes for backing off, 0 if unlimited
+     */
+    ConcurrencyController(size_t maxWorkers, bool adaptive, uint64_t memoryLimit);
+
+    ~ConcurrencyController();
+
+    /***
+     * Get the number of worker threads to start
+     * @return maximum concurrency
+     */
+    size_t workers() const { return maxWorkers; }
+
+    /***
+     * Wait until another document may be converted
+     */
+    void acquire();
+
+    /***
+     * Finish converting a document or a slice of a preempted document
+     * @param pages number of converted pages
+     * @param finished false if the document was preempted
+     */
+    void release(size_t pages, bool finished = true);
+
+    /***
+     * Get the threads a converting worker may use for a parallel step, its share of the concurrency limit
+     * @return threads, at least 1
+     */
+    size_t share();
+
+    /***
+     * Get concurrency decisions and totals for the metrics report
+     * @return metrics as JSON object
+     */
+    nlohmann::json metrics();
+
+private:
+    /***
+     * Adjust the concurrency limit once per interval
+     */
+    void control();
+
+    size_t maxWorkers;
+    bool adaptive;
+    uint64_t memoryLimit;
+
+    std::mutex mutex;
+    std::condition_variable changed;
+    bool stopping = false;
+
+    size_t limit;
+    size_t active = 0;
+    size_t pages = 0;
+    size_t documents = 0;
+    size_t backoffs = 0;
+
+    std::chrono::steady_clock::time_point start;
+    nlohmann::json history = nlohmann::json::array();
+    std::thread controller;
+};
+
+#endif //PDF2TEXT_CONCURRENCY_H
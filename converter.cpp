@@ -0,0 +1,870 @@
+#include "converter.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <regex>
+#include <sstream>
+#include <string_view>
+#include <thread>
+#include <poppler/cpp/poppler-page.h>
+#include "alloc_stats.h"
+#include "chunker.h"
+#include "hash.h"
+#include "perf_counters.h"
+#include "pipeline.h"
+#include "profiler.h"
+#include "utf8.h"
+
+/***
+ * Get Levenshtein distance of 2 strings
+ * @param s1 first string
+ * @param s2 second string
+ * @return Levenshtein distance of both strings
+ */
+unsigned int distance(const std::string& s1, const std::string& s2)
+{
+    std::vector<unsigned int> rows;
+    return distance(s1, s2, rows);
+}
+
+unsigned int distance(std::string_view s1, std::string_view s2, std::vector<unsigned int>& rows) {
+    const std::size_t len1 = s1.size(), len2 = s2.size();
+
+    // only the previous row of the matrix is needed, the buffer grows once to the longest title
+    if(rows.size() < 2 * (len2 + 1)) {
+        rows.resize(2 * (len2 + 1));
+    }
+    unsigned int* previous = rows.data();
+    unsigned int* current = previous + len2 + 1;
+
+    for(unsigned int j = 0; j <= len2; ++j) previous[j] = j;
+
+    for(unsigned int i = 1; i <= len1; ++i) {
+        current[0] = i;
+        for(unsigned int j = 1; j <= len2; ++j) {
+            current[j] = std::min({previous[j] + 1, current[j - 1] + 1,
+                                   previous[j - 1] + (s1[i - 1] == s2[j - 1] ? 0 : 1)});
+        }
+        std::swap(previous, current);
+    }
+    return previous[len2];
+}
+
+TitleMatch findTitle(const std::string& content, const std::string& separator) {
+    // Levenshtein distance of section title and page content and title position
+    unsigned int dist = -1;
+    int pos = 0;
+
+    std::vector<unsigned int> rows(2 * (separator.size() + 1));
+    std::string_view page(content);
+    {
+        // every window is a view into the page and reuses the distance rows
+        AllocationRegion region("title window loop");
+
+        // iterate over page from bottom to top
+        for(int i = (int)content.size() - (int)separator.size(); i >= (int)separator.size(); i--) {
+            unsigned int dist_before = dist;
+
+            // select substring with current section title's length
+            std::string_view substring = page.substr(i - separator.size(), separator.size());
+
+            // calculate Levenshtein distance
+            dist = std::min(dist, distance(substring, separator, rows));
+
+            // distance decreased
+            if(dist != dist_before) {
+                // update position
+                pos = i - (int) separator.size();
+            }
+
+            // stop, if exact match found
+            if(dist == 0) {
+                break;
+            }
+        }
+    }
+
+    // shift start position of section to the left if section starts with special unicode characters
+    while(pos > 0 && char(content[pos]) < 0) {
+        pos--;
+    }
+
+    return {dist, pos};
+}
+
+bool titleMatches(const TitleMatch& match, const std::string& separator, float threshold) {
+    // similarity threshold for section title detection
+    return (float)match.dist <= std::round((float)separator.length() * threshold);
+}
+
+/***
+ * Extract the text of a PDF page into sections
+ * @param sections list for all section titles
+ * @param sectionTexts list of all sections
+ * @param content PDF page content
+ * @param usedSections list of already processed sections
+ * @param threshold maximum Levenshtein distance of a title match relative to the title length
+ * @param find title search, replaced to reuse matches across thresholds
+ */
+void extractText(std::stack<std::string>& sections, std::vector<std::string>& sectionTexts,
+                 std::string content, std::queue<std::string>& usedSections, float threshold,
+                 const std::function<TitleMatch(const std::string&, const std::string&)>& find) {
+    extractSections(sections, sectionTexts, std::move(content), usedSections, threshold, find);
+}
+
+/***
+ * Convert PDF unicode string to basic UTF-8 string
+ * @param text PDF unicode string
+ * @return converted basic string
+ */
+std::string toUTF8(const poppler::ustring& text) {
+    poppler::byte_array titleArray = text.to_utf8();
+    return std::string { titleArray.data(), titleArray.size() };
+}
+
+/***
+ * Read the table of contents of a PDF file
+ * @param tocStack list of all section titles
+ * @param tocItem root node of ToC tree
+ */
+void loadTOC(std::stack<std::string>& tocStack, const poppler::toc_item& tocItem) {
+    for(poppler::toc_item* section: tocItem.children()) {
+        std::string label = toUTF8(section->title());
+
+        // remove multiple white spaces
+        std::regex space_re(R"(\s+)");
+        label = std::regex_replace(label, space_re, " ");
+
+        tocStack.push(label);
+    }
+}
+
+/***
+ * Classify the text layer of a PDF by sampling a few evenly spaced pages
+ * @param pageCount number of pages
+ * @param pageText callback returning the text of a page, only called for sampled pages
+ * @param samples maximum number of pages to sample
+ * @return text layer classification, Text for documents without pages
+ */
+TextLayer triageDocument(int pageCount, const std::function<std::string(int)>& pageText, int samples) {
+    // nothing to sample proves no missing text layer either
+    if(pageCount <= 0) {
+        return TextLayer::Text;
+    }
+
+    int sampleCount = std::min(pageCount, samples);
+    int textPages = 0;
+
+    for(int s = 0; s < sampleCount; s++) {
+        // spread samples from first to last page
+        int index = sampleCount > 1 ? (int)((long long)s * (pageCount - 1) / (sampleCount - 1)) : 0;
+        std::string text = pageText(index);
+
+        // a few visible characters are enough to prove a text layer
+        int visible = 0;
+        for(char c: text) {
+            if(!std::isspace((unsigned char)c) && ++visible >= 16) {
+                textPages++;
+                break;
+            }
+        }
+    }
+
+    if(textPages == 0) {
+        return TextLayer::ImageOnly;
+    }
+    return textPages < sampleCount ? TextLayer::Partial : TextLayer::Text;
+}
+
+// estimated output size from which sections are serialized in parallel
+static const size_t parallelSerializeBytes = 8 << 20;
+
+std::string optionsFingerprint(const ConversionOptions& options) {
+    std::ostringstream threshold;
+    threshold << options.threshold;
+
+    std::string fingerprint = "version=1;format=json;matcher=levenshtein;threshold=" + threshold.str() +
+                              ";triage=5;language=" + options.language;
+
+    for(const std::string& section: options.sections) {
+        fingerprint += ";section=" + section;
+    }
+    if(options.paragraphs) {
+        fingerprint += ";paragraphs";
+    }
+    if(options.dedup != DedupMode::Off) {
+        fingerprint += ";dedup=" + std::to_string((int)options.dedup);
+    }
+    if(options.chunkSize > 0) {
+        fingerprint += ";chunk=" + std::to_string(options.chunkSize) + "/" + std::to_string(options.chunkOverlap);
+    }
+    return fingerprint;
+}
+
+/***
+ * Check if a line ends a sentence, ignoring trailing whitespace and closing quotes or brackets
+ * @param line text line
+ * @return true if the last visible character is a sentence terminator
+ */
+static bool endsSentence(std::string_view line) {
+    size_t end = line.size();
+    while(end > 0 && (std::isspace((unsigned char)line[end - 1]) || line[end - 1] == '"' || line[end - 1] == ')' ||
+                      line[end - 1] == '\'')) {
+        end--;
+    }
+    return end > 0 && (line[end - 1] == '.' || line[end - 1] == '!' || line[end - 1] == '?' || line[end - 1] == ':');
+}
+
+std::string normalizeParagraphs(const std::string& text) {
+    // split into lines, memchr scans a word at a time
+    std::vector<std::string_view> lines;
+    size_t longest = 0;
+    for(size_t start = 0; start <= text.size();) {
+        const void* found = std::memchr(text.data() + start, '\n', text.size() - start);
+        size_t end = found != nullptr ? (const char*)found - text.data() : text.size();
+
+        lines.emplace_back(text.data() + start, end - start);
+        longest = std::max(longest, end - start);
+        start = end + 1;
+    }
+
+    std::string result;
+    result.reserve(text.size());
+    bool pendingBreak = false;
+
+    for(std::string_view line: lines) {
+        bool blank = true;
+
+        // collapse whitespace runs inside the line
+        for(char c: line) {
+            if(std::isspace((unsigned char)c)) {
+                if(!result.empty() && result.back() != ' ' && result.back() != '\n') {
+                    result.push_back(' ');
+                }
+                continue;
+            }
+
+            if(blank && !result.empty()) {
+                if(result.back() == ' ') {
+                    result.back() = pendingBreak ? '\n' : ' ';
+                }
+                else if(result.back() != '\n') {
+                    result.push_back(pendingBreak ? '\n' : ' ');
+                }
+            }
+            result.push_back(c);
+            blank = false;
+        }
+
+        // a blank line, or a sentence ending well before the right margin, closes the paragraph
+        if(blank) {
+            pendingBreak = pendingBreak || !result.empty();
+        }
+        else {
+            pendingBreak = endsSentence(line) && line.size() < longest * 3 / 4;
+        }
+    }
+
+    while(!result.empty() && (result.back() == ' ' || result.back() == '\n')) {
+        result.pop_back();
+    }
+    return result;
+}
+
+std::string PopplerBackend::pageText(const poppler::document& document, int index) {
+    // load page and read text
+    std::unique_ptr<poppler::page> page(document.create_page(index));
+    return page != nullptr ? toUTF8(page->text()) : "";
+}
+
+template<typename Backend, typename Normalizer, typename Matcher>
+std::string Pipeline<Backend, Normalizer, Matcher>::pageText(CachedDocument& document, int index, bool keep) {
+    std::string text;
+    if(!keep && document.pageTexts.take(index, text)) {
+        return text;
+    }
+
+    const std::string* found = document.pageTexts.find(index);
+    if(found != nullptr) {
+        return *found;
+    }
+
+    {
+        StageScope scope(Stage::Text);
+
+        // broken font encodings produce invalid UTF-8, repaired before it reaches any later stage
+        std::string raw = Backend::pageText(*document.document, index);
+        document.utf8Repairs += repairUTF8(raw);
+        text = Normalizer::normalize(raw);
+        addStageBytes(Stage::Text, text.size());
+    }
+
+    if(keep) {
+        document.pageTexts.put(index, text);
+    }
+    return text;
+}
+
+template<typename Backend, typename Normalizer, typename Matcher>
+bool Pipeline<Backend, Normalizer, Matcher>::convertPages(Conversion& conversion, const ConversionOptions& options,
+                                                          const std::function<bool()>& preempt) {
+    // iterate over all pages from back to front, texts kept by the triage are taken over and no text is kept, a
+    // cached document is reused through its resolved sections and releaseDocument() drops its page texts
+    while(conversion.nextPage >= 0) {
+        std::string sectionText = pageText(*conversion.document, conversion.nextPage--, false);
+
+        // find sections in page text
+        {
+            StageScope scope(Stage::Match);
+            addStageBytes(Stage::Match, sectionText.size());
+            extractSections(conversion.sections, conversion.sectionTexts, std::move(sectionText),
+                            conversion.usedSections, options.threshold, Matcher());
+        }
+
+        if(conversion.nextPage >= 0 && preempt && preempt()) {
+            return false;
+        }
+    }
+    return true;
+}
+
+template struct Pipeline<PopplerBackend, WhitespaceNormalizer, LevenshteinMatcher>;
+template struct Pipeline<PopplerBackend, ParagraphNormalizer, LevenshteinMatcher>;
+
+std::string pageText(CachedDocument& document, int index, bool keep) {
+    if(document.paragraphs) {
+        return Pipeline<PopplerBackend, ParagraphNormalizer, LevenshteinMatcher>::pageText(document, index, keep);
+    }
+    return Pipeline<PopplerBackend, WhitespaceNormalizer, LevenshteinMatcher>::pageText(document, index, keep);
+}
+
+/***
+ * Get the identity of a PDF for the document cache
+ * @param input file or archive member
+ * @param data in-memory PDF content, nullptr for files
+ * @return content hash for in-memory PDFs, path, size and modification time for files
+ */
+static std::string documentKey(const Input& input, const std::vector<char>* data) {
+    if(data != nullptr) {
+        return "data:" + std::to_string(xxh64({data->data(), data->size()})) + ":" + std::to_string(data->size());
+    }
+
+    std::error_code error;
+    auto modified = std::filesystem::last_write_time(input.path, error).time_since_epoch().count();
+    return "file:" + input.path + ":" + std::to_string(std::filesystem::file_size(input.path, error)) + ":" +
+           std::to_string(modified);
+}
+
+std::unique_ptr<Conversion> startConversion(const Input& input, const std::shared_ptr<const std::vector<char>>& data,
+                                            const ConversionOptions& options, OutputWriter& writer,
+                                            DocumentCache* cache) {
+    StageScope scope(Stage::Open);
+    auto conversion = std::make_unique<Conversion>();
+    conversion->cache = cache;
+
+    // a hot document skips opening and parsing its ToC
+    if(cache != nullptr) {
+        conversion->documentKey = documentKey(input, data.get()) + (options.paragraphs ? ":paragraphs" : "");
+        conversion->document = cache->acquire(conversion->documentKey);
+    }
+
+    if(conversion->document == nullptr) {
+        auto document = std::make_shared<CachedDocument>();
+        document->busy = true;
+        document->data = data;
+        document->paragraphs = options.paragraphs;
+        document->compress = options.compressText;
+        document->pageTexts = TextStore(options.compressText);
+
+        // open PDF
+        document->document.reset(data != nullptr
+                ? poppler::document::load_from_raw_data(data->data(), (int)data->size())
+                : poppler::document::load_from_file(input.path));
+
+        if(document->document == nullptr) {
+            writer.skip(input, "failed to open");
+            return nullptr;
+        }
+
+        std::error_code error;
+        document->fileSize = data != nullptr ? 0 : std::filesystem::file_size(input.path, error);
+        addStageBytes(Stage::Open, data != nullptr ? data->size() : document->fileSize);
+
+        // read title
+        document->title = toUTF8(document->document->get_title());
+        document->utf8Repairs += repairUTF8(document->title);
+
+        // table of contents of the PDF
+        document->toc.reset(document->document->create_toc());
+
+        // ToC available
+        if(document->toc != nullptr) {
+            std::stack<std::string> titles;
+            loadTOC(titles, *document->toc->root());
+
+            for(; !titles.empty(); titles.pop()) {
+                document->titles.insert(document->titles.begin(), titles.top());
+                document->utf8Repairs += repairUTF8(document->titles.front());
+            }
+        }
+        else {
+            // Log unsupported file
+            std::cout << document->title << std::endl;
+            writer.skip(input, "no table of contents");
+            return nullptr;
+        }
+
+        conversion->document = document;
+    }
+
+    CachedDocument& document = *conversion->document;
+    document.unpack();
+    conversion->pageCount = document.document->pages();
+
+    // empty or broken documents are no scans, report them as what they are
+    if(conversion->pageCount <= 0) {
+        writer.skip(input, "no pages");
+        return nullptr;
+    }
+
+    // skip scanned documents without a text layer before extracting every page, sampled pages are kept
+    if(!document.resolved &&
+       triageDocument(conversion->pageCount, [&](int index) { return pageText(document, index, true); }) ==
+       TextLayer::ImageOnly) {
+        writer.skip(input, "image-only, no text layer");
+        return nullptr;
+    }
+
+    for(const std::string& title: document.titles) {
+        conversion->sections.push(title);
+    }
+
+    // resolved documents need no page at all
+    conversion->nextPage = document.resolved ? -1 : conversion->pageCount - 1;
+    return conversion;
+}
+
+bool convertPages(Conversion& conversion, const ConversionOptions& options, const std::function<bool()>& preempt) {
+    // the pipeline is selected once per document, its page loop has no runtime choices left
+    if(conversion.document->paragraphs) {
+        return Pipeline<PopplerBackend, ParagraphNormalizer, LevenshteinMatcher>::convertPages(conversion, options,
+                                                                                               preempt);
+    }
+    return Pipeline<PopplerBackend, WhitespaceNormalizer, LevenshteinMatcher>::convertPages(conversion, options,
+                                                                                            preempt);
+}
+
+/***
+ * Append a string as escaped JSON string literal, byte-identical to nlohmann::json::dump()
+ * @param out serialized output
+ * @param text unescaped string
+ */
+static void appendString(std::string& out, std::string_view text) {
+    static const char hex[] = "0123456789abcdef";
+    out.push_back('"');
+
+    size_t start = 0;
+    for(size_t i = 0; i < text.size(); i++) {
+        unsigned char c = text[i];
+        if(c >= 0x20 && c != '"' && c != '\\') {
+            continue;
+        }
+
+        out.append(text, start, i - start);
+        start = i + 1;
+
+        switch(c) {
+            case '"': out.append("\\\""); break;
+            case '\\': out.append("\\\\"); break;
+            case '\b': out.append("\\b"); break;
+            case '\f': out.append("\\f"); break;
+            case '\n': out.append("\\n"); break;
+            case '\r': out.append("\\r"); break;
+            case '\t': out.append("\\t"); break;
+            default:
+                out.append("\\u00");
+                out.push_back(hex[c >> 4]);
+                out.push_back(hex[c & 0xf]);
+        }
+    }
+
+    out.append(text, start, text.size() - start);
+    out.push_back('"');
+}
+
+/***
+ * Format a hash as 16 hex digits into a caller buffer, so records are serialized without a temporary string
+ * @param hash hash value
+ * @param hex buffer for the digits and the terminating null
+ * @return view of the digits
+ */
+static std::string_view hexHash(uint64_t hash, char (&hex)[17]) {
+    std::snprintf(hex, sizeof(hex), "%016llx", (unsigned long long)hash);
+    return {hex, 16};
+}
+
+/***
+ * Format a hash as 16 hex digits
+ * @param hash hash value
+ * @return hex string
+ */
+static std::string hexHash(uint64_t hash) {
+    char hex[17];
+    return std::string(hexHash(hash, hex));
+}
+
+/***
+ * A written record, a whole section, one of its paragraphs or one of its chunks
+ */
+struct SectionRecord {
+    // index of the section
+    size_t section;
+    std::string_view text;
+    // 1-based paragraph or chunk number within the section, 0 for whole sections
+    size_t ordinal;
+    // byte offset of the text in the section
+    size_t offset;
+    // SimHash of the text if duplicates are detected
+    uint64_t simhash = 0;
+    // index of the earlier section this record duplicates, -1 for originals
+    int original = -1;
+};
+
+/***
+ * Serialize a contiguous range of records, the texts were repaired to valid UTF-8 when they were extracted, so
+ * the strings are escaped without validation
+ * @param document resolved document
+ * @param records written records
+ * @param originals earlier sections referenced by duplicate records
+ * @param input converted file or archive member
+ * @param options conversion options
+ * @param first index of the first record
+ * @param last index after the last record
+ * @param out serialized output, opens the list at the first record and closes it at the last one
+ */
+static void serializeRange(const CachedDocument& document, const std::vector<SectionRecord>& records,
+                           const std::vector<SectionOrigin>& originals, const Input& input,
+                           const ConversionOptions& options, size_t first, size_t last, std::string& out) {
+    size_t bytes = 0;
+    for(size_t r = first; r < last; r++) {
+        bytes += records[r].text.size() + 128;
+    }
+    out.reserve(bytes + bytes / 16);
+
+    // keys in the sorted order of nlohmann::json objects
+    for(size_t r = first; r < last; r++) {
+        const SectionRecord& record = records[r];
+        out.append(r == 0 ? "[{" : ",{");
+        if(record.original >= 0) {
+            const SectionOrigin& original = originals[record.original];
+            out.append("\"duplicate_of\":{\"ordinal\":");
+            out.append(std::to_string(original.ordinal));
+            out.append(",\"paragraph\":");
+            appendString(out, original.paragraph);
+            out.append(",\"path\":");
+            appendString(out, original.path);
+            out.append("},");
+        }
+        out.append("\"language\":");
+        appendString(out, options.language);
+        if(options.chunkSize > 0) {
+            out.append(",\"offset\":");
+            out.append(std::to_string(record.offset));
+        }
+        if(options.paragraphs || options.chunkSize > 0) {
+            out.append(",\"ordinal\":");
+            out.append(std::to_string(record.ordinal));
+        }
+        out.append(",\"paragraph\":");
+        appendString(out, document.sectionTitles[record.section]);
+        if(options.dedup != DedupMode::Off) {
+            char hex[17];
+            out.append(",\"simhash\":");
+            appendString(out, hexHash(record.simhash, hex));
+        }
+        out.append(",\"text\":");
+        appendString(out, record.text);
+        out.append(",\"title\":");
+        appendString(out, document.title);
+        out.append(",\"topic\":");
+        appendString(out, input.topic);
+        out.push_back('}');
+    }
+
+    if(last == records.size()) {
+        out.push_back(']');
+    }
+}
+
+/***
+ * Serialize the records of a large document on the worker's share of the pool, one contiguous chunk per thread
+ * @param document resolved document
+ * @param records written records
+ * @param originals earlier sections referenced by duplicate records
+ * @param input converted file or archive member
+ * @param options conversion options
+ * @return chunks that form the serialized record list in order
+ */
+static std::vector<std::string> serializeSections(const CachedDocument& document,
+                                                  const std::vector<SectionRecord>& records,
+                                                  const std::vector<SectionOrigin>& originals, const Input& input,
+                                                  const ConversionOptions& options) {
+    // idle slots of the concurrency limit, so a full pool or a CPU quota is never oversubscribed
+    size_t threads = options.controller != nullptr ? std::min<size_t>(options.controller->share(), 16) : 1;
+    threads = std::min(threads, records.size());
+
+    std::vector<std::string> chunks(threads);
+    if(threads == 1) {
+        serializeRange(document, records, originals, input, options, 0, records.size(), chunks[0]);
+        return chunks;
+    }
+
+    std::vector<std::thread> pool;
+    for(size_t t = 0; t < threads; t++) {
+        pool.emplace_back([&, t]() {
+            serializeRange(document, records, originals, input, options, records.size() * t / threads,
+                           records.size() * (t + 1) / threads, chunks[t]);
+        });
+    }
+
+    for(std::thread& thread: pool) {
+        thread.join();
+    }
+    return chunks;
+}
+
+/***
+ * Get the content hash of a converted PDF
+ * @param document converted document
+ * @param input converted file or archive member
+ * @return hash as hex string, empty if the file cannot be read
+ */
+static std::string contentHash(const CachedDocument& document, const Input& input) {
+    // files are still in the page cache after poppler read them
+    std::vector<char> content;
+    const std::vector<char>* data = document.data.get();
+    if(data == nullptr && readFile(input.path, content)) {
+        data = &content;
+    }
+    return data != nullptr ? hexHash(xxh64({data->data(), data->size()})) : "";
+}
+
+/***
+ * Build the SQLite row set of a converted document
+ * @param document resolved document
+ * @param records written records
+ * @param input converted file or archive member
+ * @param options conversion options
+ * @return document with copies of the record texts
+ */
+static SqliteDocument sqliteDocument(const CachedDocument& document, const std::vector<SectionRecord>& records,
+                                     const Input& input, const ConversionOptions& options) {
+    SqliteDocument result;
+    result.input = input;
+    result.title = document.title;
+    result.language = options.language;
+    result.hash = contentHash(document, input);
+
+    for(const SectionRecord& record: records) {
+        result.sections.push_back({document.sectionTitles[record.section], record.ordinal, record.offset,
+                                   std::string(record.text),
+                                   options.dedup != DedupMode::Off ? hexHash(record.simhash) : ""});
+    }
+    return result;
+}
+
+/***
+ * Return the document of a finished conversion to the document cache, or close it
+ * @param conversion conversion state
+ */
+static void releaseDocument(Conversion& conversion) {
+    // keep the document hot for the next request
+    if(conversion.cache != nullptr) {
+        conversion.document->pageTexts.clear();
+        conversion.cache->release(conversion.documentKey, conversion.document);
+    }
+    conversion.document.reset();
+}
+
+std::vector<std::string> finishConversion(Conversion& conversion, const Input& input, const ConversionOptions& options,
+                             OutputWriter& writer) {
+    StageScope scope(Stage::Serialize);
+    CachedDocument& document = *conversion.document;
+
+    if(!document.resolved) {
+        std::vector<std::string>& sectionTexts = conversion.sectionTexts;
+        std::queue<std::string>& usedSections = conversion.usedSections;
+
+        // remove sections not related to section titles
+        while(sectionTexts.size() > usedSections.size()) {
+            sectionTexts.erase(sectionTexts.end());
+        }
+
+        document.sectionTexts = std::move(sectionTexts);
+        for(; !usedSections.empty(); usedSections.pop()) {
+            document.sectionTitles.push_back(usedSections.front());
+        }
+        document.resolved = true;
+    }
+
+    // repairs are reported per written document, cached documents were repaired once when they were extracted
+    conversion.repairs = document.utf8Repairs;
+    countRepairs(conversion.repairs);
+
+    // targeted extraction of selected sections, split into paragraphs or chunks on request
+    std::vector<SectionRecord> records;
+    size_t estimate = 2;
+    for(size_t i = 0; i < document.sectionTexts.size(); i++) {
+        if(!options.sections.empty() &&
+           std::find(options.sections.begin(), options.sections.end(), document.sectionTitles[i]) ==
+           options.sections.end()) {
+            continue;
+        }
+
+        const std::string& text = document.sectionTexts[i];
+        if(options.chunkSize > 0) {
+            size_t ordinal = 0;
+            for(const Chunk& chunk: chunkText(text, options.chunkSize, options.chunkOverlap)) {
+                records.push_back({i, std::string_view(text).substr(chunk.offset, chunk.length), ++ordinal,
+                                   chunk.offset});
+            }
+        }
+        else if(options.paragraphs) {
+            size_t ordinal = 0;
+            for(size_t start = 0; start < text.size();) {
+                const void* found = std::memchr(text.data() + start, '\n', text.size() - start);
+                size_t end = found != nullptr ? (const char*)found - text.data() : text.size();
+
+                std::string_view paragraph(text.data() + start, end - start);
+                while(!paragraph.empty() && paragraph.front() == ' ') {
+                    paragraph.remove_prefix(1);
+                }
+                while(!paragraph.empty() && paragraph.back() == ' ') {
+                    paragraph.remove_suffix(1);
+                }
+                if(!paragraph.empty()) {
+                    records.push_back({i, paragraph, ++ordinal, (size_t)(paragraph.data() - text.data())});
+                }
+                start = end + 1;
+            }
+        }
+        else {
+            records.push_back({i, text, 0, 0});
+        }
+    }
+
+    // the path names the document in duplicate references and the index, which need valid UTF-8
+    std::string path = input.path;
+    repairUTF8(path);
+
+    // near-duplicates of earlier sections in the run are flagged, suppressed or referenced
+    std::vector<SectionOrigin> originals;
+    if(options.dedup != DedupMode::Off && options.duplicates != nullptr) {
+        std::vector<SectionRecord> unique;
+
+        for(SectionRecord& record: records) {
+            size_t words;
+            record.simhash = simhash(record.text, words);
+
+            // short sections are too similar by chance
+            SectionOrigin original;
+            if(words >= 16 &&
+               options.duplicates->findOrInsert(record.simhash, {path, document.sectionTitles[record.section],
+                                                                 record.ordinal}, original)) {
+                if(options.dedup == DedupMode::Suppress) {
+                    continue;
+                }
+                if(options.dedup == DedupMode::Reference) {
+                    record.text = {};
+                }
+                record.original = (int)originals.size();
+                originals.push_back(original);
+            }
+            unique.push_back(record);
+        }
+        records = std::move(unique);
+    }
+
+    // index the written records while their text is still hot
+    if(options.index != nullptr) {
+        StageScope indexing(Stage::Index);
+        for(const SectionRecord& record: records) {
+            if(!record.text.empty()) {
+                addStageBytes(Stage::Index, record.text.size());
+                options.index->add(path, document.sectionTitles[record.section], record.ordinal, record.text);
+            }
+        }
+    }
+
+    // the SQLite sink takes the records instead of serialized JSON
+    if(options.sqlite != nullptr) {
+        conversion.sectionCount = records.size();
+        options.sqlite->submit(sqliteDocument(document, records, input, options));
+        releaseDocument(conversion);
+        return {};
+    }
+
+    for(const SectionRecord& record: records) {
+        estimate += record.text.size() + document.sectionTitles[record.section].size() + document.title.size() +
+                    input.topic.size() + options.language.size() + 64;
+    }
+    conversion.sectionCount = records.size();
+
+    std::vector<std::string> output;
+    if(estimate >= parallelSerializeBytes) {
+        output = serializeSections(document, records, originals, input, options);
+    }
+    else if(!records.empty()) {
+        output.emplace_back();
+        serializeRange(document, records, originals, input, options, 0, records.size(), output.back());
+    }
+    else {
+        // an empty document is the line of an empty nlohmann::json
+        output.emplace_back("null");
+    }
+
+    // the merge tool takes the content hash of its SQLite output from the manifest
+    std::string hash = writer.hasManifest() ? contentHash(document, input) : "";
+
+    // write json format of section list to the output
+    {
+        StageScope writing(Stage::Write);
+        writer.write(input, output, conversion.sectionCount, conversion.repairs, hash);
+    }
+    for(const std::string& chunk: output) {
+        addStageBytes(Stage::Serialize, chunk.size());
+        addStageBytes(Stage::Write, chunk.size());
+    }
+
+    releaseDocument(conversion);
+    return output;
+}
+
+size_t countPages(const Input& input, const std::vector<char>* data) {
+    // opening a PDF only parses its cross reference table and page tree
+    std::unique_ptr<poppler::document> document(data != nullptr
+            ? poppler::document::load_from_raw_data(data->data(), (int)data->size())
+            : poppler::document::load_from_file(input.path));
+
+    return document != nullptr ? document->pages() : 0;
+}
+
+size_t convertPDF(const Input& input, const std::vector<char>* data, const ConversionOptions& options,
+                  OutputWriter& writer) {
+    // the caller keeps the data alive during the conversion
+    std::shared_ptr<const std::vector<char>> view(data, [](const std::vector<char>*) {});
+
+    std::unique_ptr<Conversion> conversion = startConversion(input, view, options, writer, nullptr);
+    if(conversion == nullptr) {
+        return 0;
+    }
+
+    convertPages(*conversion, options, nullptr);
+    finishConversion(*conversion, input, options, writer);
+    return conversion->pageCount;
+}
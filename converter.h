@@ -0,0 +1,239 @@
+#ifndef PDF2TEXT_CONVERTER_H
+#define PDF2TEXT_CONVERTER_H
+
+#include <functional>
+#include <memory>
+#include <queue>
+#include <stack>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <poppler/cpp/poppler-document.h>
+#include <poppler/cpp/poppler-toc.h>
+#include "concurrency.h"
+#include "dedup.h"
+#include "document_cache.h"
+#include "index.h"
+#include "input.h"
+#include "output.h"
+#include "sqlite_sink.h"
+
+/***
+ * Get Levenshtein distance of 2 strings
+ * @param s1 first string
+ * @param s2 second string
+ * @return Levenshtein distance of both strings
+ */
+unsigned int distance(const std::string& s1, const std::string& s2);
+
+/***
+ * Get Levenshtein distance of 2 strings without allocating once the row buffer fits
+ * @param s1 first string
+ * @param s2 second string
+ * @param rows buffer of two matrix rows, grown to 2 * (s2.size() + 1) if smaller
+ * @return Levenshtein distance of both strings
+ */
+unsigned int distance(std::string_view s1, std::string_view s2, std::vector<unsigned int>& rows);
+
+/***
+ * Best match of a section title in page content
+ */
+struct TitleMatch {
+    // Levenshtein distance, -1 if the content is too short
+    unsigned int dist;
+    // start of the title in the content
+    int pos;
+};
+
+/***
+ * Find the position with the lowest Levenshtein distance to a section title, searching from bottom to top
+ * @param content PDF page content
+ * @param separator section title
+ * @return best match
+ */
+TitleMatch findTitle(const std::string& content, const std::string& separator);
+
+/***
+ * Check if a match is close enough to count as the section title
+ * @param match best match of the title
+ * @param separator section title
+ * @param threshold maximum Levenshtein distance relative to the title length
+ * @return true if the title was found
+ */
+bool titleMatches(const TitleMatch& match, const std::string& separator, float threshold);
+
+/***
+ * Extract the text of a PDF page into sections with a type-erased title search, see extractSections() in pipeline.h
+ * @param sections list for all section titles
+ * @param sectionTexts list of all sections
+ * @param content PDF page content
+ * @param usedSections list of already processed sections
+ * @param threshold maximum Levenshtein distance of a title match relative to the title length
+ * @param find title search, replaced to reuse matches across thresholds
+ */
+void extractText(std::stack<std::string>& sections, std::vector<std::string>& sectionTexts,
+                 std::string content, std::queue<std::string>& usedSections, float threshold = 0.1f,
+                 const std::function<TitleMatch(const std::string&, const std::string&)>& find = findTitle);
+
+/***
+ * Convert PDF unicode string to basic UTF-8 string
+ * @param text PDF unicode string
+ * @return converted basic string
+ */
+std::string toUTF8(const poppler::ustring& text);
+
+/***
+ * Read the table of contents of a PDF file
+ * @param tocStack list of all section titles
+ * @param tocItem root node of ToC tree
+ */
+void loadTOC(std::stack<std::string>& tocStack, const poppler::toc_item& tocItem);
+
+/***
+ * Classification of the text layer of a PDF document
+ */
+enum class TextLayer {
+    Text,
+    Partial,
+    ImageOnly
+};
+
+/***
+ * Classify the text layer of a PDF by sampling a few evenly spaced pages
+ * @param pageCount number of pages
+ * @param pageText callback returning the text of a page
+ * @param samples maximum number of pages to sample
+ * @return text layer classification, Text for documents without pages
+ */
+TextLayer triageDocument(int pageCount, const std::function<std::string(int)>& pageText, int samples = 5);
+
+/***
+ * Options that change the conversion output
+ */
+struct ConversionOptions {
+    // PDF text language
+    std::string language;
+    // maximum Levenshtein distance of a title match relative to the title length
+    float threshold = 0.1f;
+    // split sections into paragraph records with ordinal numbers
+    bool paragraphs = false;
+    // keep page texts and cached sections LZ4 compressed while they are not matched
+    bool compressText = false;
+    // maximum chunk size in bytes, 0 to write whole sections
+    size_t chunkSize = 0;
+    // bytes repeated from the end of the previous chunk
+    size_t chunkOverlap = 0;
+    // handling of near-duplicates of earlier sections
+    DedupMode dedup = DedupMode::Off;
+    // run-wide SimHash table, required if dedup is enabled
+    std::shared_ptr<DuplicateIndex> duplicates;
+    // inverted index of the written records, nullptr to disable it
+    std::shared_ptr<IndexWriter> index;
+    // SQLite output replacing the JSON output, nullptr to write JSON
+    std::shared_ptr<SqliteSink> sqlite;
+    // section titles to extract, empty for all sections
+    std::vector<std::string> sections;
+    // gate of the worker pool, large documents serialize on their worker's share of it, nullptr for one thread
+    ConcurrencyController* controller = nullptr;
+};
+
+/***
+ * Get a fingerprint of all options that change the output, used in cache keys
+ * @param options conversion options
+ * @return fingerprint string
+ */
+std::string optionsFingerprint(const ConversionOptions& options);
+
+/***
+ * State of a document conversion, resumable at page boundaries
+ */
+struct Conversion {
+    // opened document, shared with the document cache
+    std::shared_ptr<CachedDocument> document;
+    std::string documentKey;
+    DocumentCache* cache = nullptr;
+
+    std::stack<std::string> sections;
+    std::vector<std::string> sectionTexts{""};
+    std::queue<std::string> usedSections;
+
+    int pageCount = 0;
+    // next page to convert, pages are processed from back to front
+    int nextPage = -1;
+    // number of written records
+    size_t sectionCount = 0;
+    // invalid UTF-8 sequences replaced with U+FFFD in the document
+    size_t repairs = 0;
+};
+
+/***
+ * Open a PDF, or take it from the document cache, and prepare its conversion
+ * @param input converted file or archive member
+ * @param data in-memory PDF content, nullptr to read the file
+ * @param options conversion options
+ * @param writer output for skipped files
+ * @param cache document cache of the worker, nullptr to open every document
+ * @return conversion state, nullptr if the file was skipped
+ */
+std::unique_ptr<Conversion> startConversion(const Input& input, const std::shared_ptr<const std::vector<char>>& data,
+                                            const ConversionOptions& options, OutputWriter& writer,
+                                            DocumentCache* cache);
+
+/***
+ * Collapse whitespace of a page text but keep paragraph breaks as '\n', a paragraph ends at a blank line or at a
+ * sentence terminator on a line ending well before the right margin
+ * @param text raw page text with line breaks
+ * @return normalized text
+ */
+std::string normalizeParagraphs(const std::string& text);
+
+/***
+ * Get the whitespace normalized text of a page, extracting it only once per document
+ * @param document opened document
+ * @param index page index
+ * @param keep true to keep the text for later requests
+ * @return page text
+ */
+std::string pageText(CachedDocument& document, int index, bool keep);
+
+/***
+ * Convert pages until the document is done or the caller asks to preempt it
+ * @param conversion conversion state
+ * @param options conversion options
+ * @param preempt checked after every page, true pauses the conversion
+ * @return true if all pages were converted
+ */
+bool convertPages(Conversion& conversion, const ConversionOptions& options, const std::function<bool()>& preempt);
+
+/***
+ * Write the sections of a fully converted document and return it to the document cache, large documents are
+ * serialized in parallel
+ * @param conversion conversion state
+ * @param input converted file or archive member
+ * @param options conversion options
+ * @param writer output for sections
+ * @return serialized section list in chunks, empty if the records went to the SQLite output
+ */
+std::vector<std::string> finishConversion(Conversion& conversion, const Input& input, const ConversionOptions& options,
+                             OutputWriter& writer);
+
+/***
+ * Get the page count of a PDF by opening it without converting any page
+ * @param input file or archive member
+ * @param data in-memory PDF content, nullptr to read the file
+ * @return number of pages, 0 if the file cannot be opened
+ */
+size_t countPages(const Input& input, const std::vector<char>* data);
+
+/***
+ * Convert a PDF file or an in-memory PDF into JSON list of sections
+ * @param input converted file or archive member
+ * @param data in-memory PDF content, nullptr to read the file
+ * @param options conversion options
+ * @param writer output for sections and skipped files
+ * @return number of converted pages, 0 if the file was skipped
+ */
+size_t convertPDF(const Input& input, const std::vector<char>* data, const ConversionOptions& options,
+                  OutputWriter& writer);
+
+#endif //PDF2TEXT_CONVERTER_H
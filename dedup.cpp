@@ -0,0 +1,137 @@
+#include "dedup.h"
+
+#include <algorithm>
+#include <bitset>
+#include "hash.h"
+
+bool parseDedupMode(const std::string& text, DedupMode& mode) {
+    if(text == "flag") {
+        mode = DedupMode::Flag;
+    }
+    else if(text == "suppress") {
+        mode = DedupMode::Suppress;
+    }
+    else if(text == "reference") {
+        mode = DedupMode::Reference;
+    }
+    else {
+        return false;
+    }
+    return true;
+}
+
+/***
+ * Mix a 64 bit value, the finalizer of SplitMix64
+ * @param value input value
+ * @return well distributed value
+ */
+static uint64_t mix(uint64_t value) {
+    value = (value ^ (value >> 30)) * 0xbf58476d1ce4e5b9ull;
+    value = (value ^ (value >> 27)) * 0x94d049bb133111ebull;
+    return value ^ (value >> 31);
+}
+
+uint64_t simhash(std::string_view text, size_t& words) {
+    int counts[64] = {0};
+    uint64_t previous[2] = {0, 0};
+    words = 0;
+
+    for(size_t pos = 0; pos < text.size();) {
+        size_t end = text.find_first_of(" \n", pos);
+        if(end == std::string_view::npos) {
+            end = text.size();
+        }
+
+        if(end > pos) {
+            // shingles are combined from word hashes, no shingle string is built
+            uint64_t word = fnv1a(text.substr(pos, end - pos));
+            if(++words >= 3) {
+                uint64_t shingle = mix(previous[0] ^ (previous[1] << 21 | previous[1] >> 43) ^ (word << 42 | word >> 22));
+                for(int bit = 0; bit < 64; bit++) {
+                    counts[bit] += (shingle >> bit & 1) ? 1 : -1;
+                }
+            }
+            previous[0] = previous[1];
+            previous[1] = word;
+        }
+        pos = end + 1;
+    }
+
+    // texts shorter than one shingle hash their words
+    if(words > 0 && words < 3) {
+        uint64_t shingle = mix(previous[0] ^ previous[1]);
+        for(int bit = 0; bit < 64; bit++) {
+            counts[bit] += (shingle >> bit & 1) ? 1 : -1;
+        }
+    }
+
+    uint64_t hash = 0;
+    for(int bit = 0; bit < 64; bit++) {
+        if(counts[bit] > 0) {
+            hash |= 1ull << bit;
+        }
+    }
+    return hash;
+}
+
+DuplicateIndex::DuplicateIndex(unsigned int maxDistance) : maxDistance(std::min(maxDistance, 5u)) {
+    // at least four blocks so that two of them fit a 32 bit key
+    int blocks = std::max((int)this->maxDistance + 2, 4);
+
+    for(int a = 0; a < blocks; a++) {
+        for(int b = a + 1; b < blocks; b++) {
+            Band band{};
+            int width[2];
+            for(int k = 0; k < 2; k++) {
+                int block = k == 0 ? a : b;
+                band.first[k] = block * 64 / blocks;
+                width[k] = (block + 1) * 64 / blocks - band.first[k];
+                band.mask[k] = (1ull << width[k]) - 1;
+            }
+            band.width = width[1];
+            bands.push_back(band);
+        }
+    }
+    tables.resize(bands.size());
+}
+
+uint32_t DuplicateIndex::bandKey(uint64_t hash, const Band& band) {
+    uint64_t high = (hash >> band.first[0]) & band.mask[0];
+    return (uint32_t)(high << band.width | ((hash >> band.first[1]) & band.mask[1]));
+}
+
+bool DuplicateIndex::findOrInsert(uint64_t hash, const SectionOrigin& origin, SectionOrigin& original) {
+    std::lock_guard<CountingMutex> lock(mutex);
+    sections++;
+
+    for(size_t band = 0; band < bands.size(); band++) {
+        auto bucket = tables[band].find(bandKey(hash, bands[band]));
+        if(bucket == tables[band].end()) {
+            continue;
+        }
+
+        for(uint32_t index: bucket->second) {
+            if(std::bitset<64>(originals[index].first ^ hash).count() <= maxDistance) {
+                original = originals[index].second;
+                duplicates++;
+                return true;
+            }
+        }
+    }
+
+    originals.emplace_back(hash, origin);
+    for(size_t band = 0; band < bands.size(); band++) {
+        tables[band][bandKey(hash, bands[band])].push_back((uint32_t)(originals.size() - 1));
+    }
+    return false;
+}
+
+nlohmann::json DuplicateIndex::metrics() {
+    std::lock_guard<CountingMutex> lock(mutex);
+
+    return {
+            {"sections", sections},
+            {"originals", originals.size()},
+            {"duplicates", duplicates}
+    };
+}
@@ -0,0 +1,109 @@
+#ifndef PDF2TEXT_DEDUP_H
+#define PDF2TEXT_DEDUP_H
+
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include "include/nlohmann/json.hpp"
+#include "lock_stats.h"
+
+/***
+ * Handling of near-duplicate sections in the output
+ */
+enum class DedupMode {
+    Off,
+    // add the hash and the original to duplicates
+    Flag,
+    // drop duplicates
+    Suppress,
+    // replace the text of duplicates by a reference to the original
+    Reference
+};
+
+/***
+ * Parse a dedup mode given as "flag", "suppress" or "reference"
+ * @param text mode name
+ * @param mode parsed mode
+ * @return false if the name is unknown
+ */
+bool parseDedupMode(const std::string& text, DedupMode& mode);
+
+/***
+ * Get the 64 bit SimHash of a text over shingles of three words
+ * @param text section text
+ * @param words number of words in the text
+ * @return SimHash, 0 for empty texts
+ */
+uint64_t simhash(std::string_view text, size_t& words);
+
+/***
+ * First occurrence of a section
+ */
+struct SectionOrigin {
+    std::string path;
+    std::string paragraph;
+    // record number within the section
+    size_t ordinal = 0;
+};
+
+/***
+ * Run-wide multi-table LSH index of section SimHashes, safe to share between workers
+ */
+class DuplicateIndex {
+public:
+    /***
+     * Create an empty index
+     * @param maxDistance maximum Hamming distance of near-duplicates, at most 5
+     */
+    explicit DuplicateIndex(unsigned int maxDistance = 5);
+
+    /***
+     * Look up a near-duplicate of an earlier section, or add the section as an original
+     * @param hash SimHash of the section
+     * @param origin location of the section
+     * @param original location of the earlier section if one was found
+     * @return true if the section is a near-duplicate
+     */
+    bool findOrInsert(uint64_t hash, const SectionOrigin& origin, SectionOrigin& original);
+
+    /***
+     * Get duplicate counters for the metrics report
+     * @return metrics as JSON object
+     */
+    nlohmann::json metrics();
+
+private:
+    /***
+     * Two blocks of the hash that together key one table
+     */
+    struct Band {
+        int first[2];
+        uint64_t mask[2];
+        int width;
+    };
+
+    /***
+     * Get the bits of a hash in a band
+     * @param hash SimHash
+     * @param band band of a table
+     * @return bits of both blocks, at least 18
+     */
+    static uint32_t bandKey(uint64_t hash, const Band& band);
+
+    unsigned int maxDistance;
+
+    CountingMutex mutex{"duplicate_index"};
+    std::vector<std::pair<uint64_t, SectionOrigin>> originals;
+    // the hash is cut into at least maxDistance + 2 blocks, near-duplicates share two of them exactly, so a table per
+    // pair of blocks finds them while the wide keys keep the candidate lists short
+    std::vector<Band> bands;
+    std::vector<std::unordered_map<uint32_t, std::vector<uint32_t>>> tables;
+
+    size_t sections = 0;
+    size_t duplicates = 0;
+};
+
+#endif //PDF2TEXT_DEDUP_H
@@ -0,0 +1,110 @@
+#include "document_cache.h"
+
+uint64_t CachedDocument::footprint() const {
+    // poppler keeps the parsed cross reference table and object streams, estimated as the file size
+    uint64_t bytes = fileSize + (data != nullptr ? data->size() : 0) + title.size();
+
+    for(const std::string& text: titles) {
+        bytes += text.size();
+    }
+    bytes += pageTexts.bytes() + packedSections.bytes();
+    for(size_t i = 0; i < sectionTitles.size(); i++) {
+        bytes += sectionTitles[i].size();
+    }
+    for(const std::string& text: sectionTexts) {
+        bytes += text.size();
+    }
+    return bytes;
+}
+
+void CachedDocument::pack() {
+    if(!compress) {
+        return;
+    }
+
+    for(size_t i = 0; i < sectionTexts.size(); i++) {
+        packedSections.put((int)i, std::move(sectionTexts[i]));
+    }
+    sectionTexts.clear();
+}
+
+void CachedDocument::unpack() {
+    if(packedSections.size() == 0) {
+        return;
+    }
+
+    sectionTexts.resize(packedSections.size());
+    for(size_t i = 0; i < sectionTexts.size(); i++) {
+        packedSections.take((int)i, sectionTexts[i]);
+    }
+    packedSections.clear();
+}
+
+DocumentCache::DocumentCache(uint64_t limit) : limit(limit) {
+}
+
+std::shared_ptr<CachedDocument> DocumentCache::acquire(const std::string& key) {
+    std::lock_guard<std::mutex> lock(mutex);
+
+    auto found = index.find(key);
+    if(found == index.end()) {
+        misses++;
+        return nullptr;
+    }
+
+    // a document in use by another conversion is opened a second time
+    std::shared_ptr<CachedDocument> document = found->second->second;
+    if(document->busy.exchange(true)) {
+        misses++;
+        return nullptr;
+    }
+
+    entries.splice(entries.begin(), entries, found->second);
+    hits++;
+    return document;
+}
+
+void DocumentCache::release(const std::string& key, const std::shared_ptr<CachedDocument>& document) {
+    document->pack();
+    uint64_t bytes = document->footprint();
+
+    std::lock_guard<std::mutex> lock(mutex);
+    auto found = index.find(key);
+
+    if(found != index.end()) {
+        used -= found->second->second->releasedFootprint;
+        entries.erase(found->second);
+        index.erase(found);
+    }
+
+    document->releasedFootprint = bytes;
+    document->busy = false;
+
+    if(bytes > limit) {
+        return;
+    }
+
+    entries.emplace_front(key, document);
+    index[key] = entries.begin();
+    used += bytes;
+
+    // documents in use stay alive through their conversion when evicted
+    while(used > limit) {
+        used -= entries.back().second->releasedFootprint;
+        index.erase(entries.back().first);
+        entries.pop_back();
+        evictions++;
+    }
+}
+
+nlohmann::json DocumentCache::metrics() {
+    std::lock_guard<std::mutex> lock(mutex);
+
+    return {
+            {"hits", hits},
+            {"misses", misses},
+            {"evictions", evictions},
+            {"documents", entries.size()},
+            {"bytes", used}
+    };
+}
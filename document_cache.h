@@ -0,0 +1,114 @@
+#ifndef PDF2TEXT_DOCUMENT_CACHE_H
+#define PDF2TEXT_DOCUMENT_CACHE_H
+
+#include <atomic>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <poppler/cpp/poppler-document.h>
+#include <poppler/cpp/poppler-toc.h>
+#include "include/nlohmann/json.hpp"
+#include "text_store.h"
+
+/***
+ * An opened PDF with everything parsed from it so far
+ */
+struct CachedDocument {
+    // in-memory PDF content, must outlive the poppler document
+    std::shared_ptr<const std::vector<char>> data;
+    // size of the PDF file
+    uint64_t fileSize = 0;
+
+    std::unique_ptr<poppler::document> document;
+    std::unique_ptr<poppler::toc> toc;
+    std::string title;
+    // section titles in ToC order
+    std::vector<std::string> titles;
+
+    // page texts keep paragraph breaks as '\n'
+    bool paragraphs = false;
+    // texts not in use are kept compressed
+    bool compress = false;
+    // normalized page texts by page index
+    TextStore pageTexts;
+    // invalid UTF-8 sequences replaced in the title, section titles and extracted pages
+    size_t utf8Repairs = 0;
+
+    // resolved sections of a fully converted document
+    bool resolved = false;
+    std::vector<std::string> sectionTexts;
+    std::vector<std::string> sectionTitles;
+    // compressed section texts while the document is cached but not in use
+    TextStore packedSections{true};
+
+    // set while a conversion uses the poppler document, which is not thread-safe
+    std::atomic<bool> busy{false};
+    // footprint when the document was last released
+    uint64_t releasedFootprint = 0;
+
+    /***
+     * Compress the resolved section texts while the document is not in use
+     */
+    void pack();
+
+    /***
+     * Restore the resolved section texts of a packed document
+     */
+    void unpack();
+
+    /***
+     * Estimate the memory held by this document
+     * @return bytes of PDF data, parsed objects and texts
+     */
+    uint64_t footprint() const;
+};
+
+/***
+ * LRU of opened documents shared by all workers, evicted by memory footprint
+ */
+class DocumentCache {
+public:
+    /***
+     * Create an empty cache
+     * @param limit bytes kept for documents that are not in use
+     */
+    explicit DocumentCache(uint64_t limit);
+
+    /***
+     * Take a cached document for exclusive use
+     * @param key document identity
+     * @return cached document, nullptr on a miss or if another conversion uses it
+     */
+    std::shared_ptr<CachedDocument> acquire(const std::string& key);
+
+    /***
+     * Return a document after use and evict least recently used documents over the limit
+     * @param key document identity
+     * @param document used document
+     */
+    void release(const std::string& key, const std::shared_ptr<CachedDocument>& document);
+
+    /***
+     * Get hit and miss counters for the metrics report
+     * @return metrics as JSON object
+     */
+    nlohmann::json metrics();
+
+private:
+    std::mutex mutex;
+    uint64_t limit;
+    uint64_t used = 0;
+    std::list<std::pair<std::string, std::shared_ptr<CachedDocument>>> entries;
+    std::unordered_map<std::string, std::list<std::pair<std::string, std::shared_ptr<CachedDocument>>>::iterator>
+            index;
+
+    size_t hits = 0;
+    size_t misses = 0;
+    size_t evictions = 0;
+};
+
+#endif //PDF2TEXT_DOCUMENT_CACHE_H
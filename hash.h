@@ -0,0 +1,102 @@
+#ifndef PDF2TEXT_HASH_H
+#define PDF2TEXT_HASH_H
+
+#include <cstdint>
+#include <cstring>
+#include <string_view>
+
+/***
+ * Get the 64 bit FNV-1a hash of a string, stable across platforms and runs
+ * @param text input string
+ * @return hash value
+ */
+inline uint64_t fnv1a(std::string_view text) {
+    uint64_t hash = 0xcbf29ce484222325ull;
+    for(char c: text) {
+        hash ^= (unsigned char)c;
+        hash *= 0x100000001b3ull;
+    }
+    return hash;
+}
+
+/***
+ * Read an unaligned little endian 64 bit word
+ * @param data source bytes
+ * @return word value
+ */
+inline uint64_t readWord64(const char* data) {
+    uint64_t value;
+    std::memcpy(&value, data, sizeof(value));
+    return value;
+}
+
+/***
+ * Read an unaligned little endian 32 bit word
+ * @param data source bytes
+ * @return word value
+ */
+inline uint32_t readWord32(const char* data) {
+    uint32_t value;
+    std::memcpy(&value, data, sizeof(value));
+    return value;
+}
+
+/***
+ * Get the XXH64 hash of a buffer, fast enough to fingerprint whole PDFs
+ * @param data input bytes
+ * @param seed hash seed
+ * @return hash value
+ */
+inline uint64_t xxh64(std::string_view data, uint64_t seed = 0) {
+    const uint64_t p1 = 0x9E3779B185EBCA87ull, p2 = 0xC2B2AE3D27D4EB4Full, p3 = 0x165667B19E3779F9ull,
+                   p4 = 0x85EBCA77C2B2AE63ull, p5 = 0x27D4EB2F165667C5ull;
+
+    auto rotate = [](uint64_t x, int r) { return (x << r) | (x >> (64 - r)); };
+    auto round = [&](uint64_t acc, uint64_t input) { return rotate(acc + input * p2, 31) * p1; };
+    auto merge = [&](uint64_t acc, uint64_t value) { return (acc ^ round(0, value)) * p1 + p4; };
+
+    const char* p = data.data();
+    const char* end = p + data.size();
+    uint64_t hash;
+
+    if(data.size() >= 32) {
+        uint64_t v1 = seed + p1 + p2, v2 = seed + p2, v3 = seed, v4 = seed - p1;
+
+        // four independent lanes over 32 byte stripes
+        do {
+            v1 = round(v1, readWord64(p));
+            v2 = round(v2, readWord64(p + 8));
+            v3 = round(v3, readWord64(p + 16));
+            v4 = round(v4, readWord64(p + 24));
+            p += 32;
+        } while(p + 32 <= end);
+
+        hash = rotate(v1, 1) + rotate(v2, 7) + rotate(v3, 12) + rotate(v4, 18);
+        hash = merge(merge(merge(merge(hash, v1), v2), v3), v4);
+    }
+    else {
+        hash = seed + p5;
+    }
+
+    hash += data.size();
+
+    for(; p + 8 <= end; p += 8) {
+        hash = rotate(hash ^ round(0, readWord64(p)), 27) * p1 + p4;
+    }
+    if(p + 4 <= end) {
+        hash = rotate(hash ^ (uint64_t)readWord32(p) * p1, 23) * p2 + p3;
+        p += 4;
+    }
+    for(; p < end; p++) {
+        hash = rotate(hash ^ (unsigned char)*p * p5, 11) * p1;
+    }
+
+    hash ^= hash >> 33;
+    hash *= p2;
+    hash ^= hash >> 29;
+    hash *= p3;
+    hash ^= hash >> 32;
+    return hash;
+}
+
+#endif //PDF2TEXT_HASH_H
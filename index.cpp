@@ -0,0 +1,438 @@
+#include "index.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <queue>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "include/nlohmann/json.hpp"
+#include "profiler.h"
+
+static const char indexMagic[8] = {'P', 'D', 'F', 'I', 'D', 'X', '1', '\0'};
+
+void tokenize(std::string_view text, const std::function<void(std::string_view)>& visitor) {
+    char term[64];
+    size_t length = 0;
+    bool tooLong = false;
+
+    for(size_t i = 0; i <= text.size(); i++) {
+        unsigned char c = i < text.size() ? text[i] : ' ';
+
+        if(std::isalnum(c) || c >= 0x80) {
+            if(length < sizeof(term)) {
+                term[length++] = (char)std::tolower(c);
+            }
+            else {
+                tooLong = true;
+            }
+            continue;
+        }
+
+        // overlong tokens are hashes or broken text, not terms
+        if(length > 0 && !tooLong) {
+            visitor({term, length});
+        }
+        length = 0;
+        tooLong = false;
+    }
+}
+
+/***
+ * Append an unsigned LEB128 varint
+ * @param out encoded bytes
+ * @param value encoded value
+ */
+static void putVarint(std::string& out, uint64_t value) {
+    while(value >= 0x80) {
+        out.push_back((char)(value | 0x80));
+        value >>= 7;
+    }
+    out.push_back((char)value);
+}
+
+/***
+ * Decode an unsigned LEB128 varint
+ * @param data encoded bytes, advanced past the varint
+ * @param end end of the encoded bytes
+ * @return decoded value
+ */
+static uint64_t getVarint(const char*& data, const char* end) {
+    uint64_t value = 0;
+    for(int shift = 0; data < end && shift < 64; shift += 7) {
+        unsigned char byte = *data++;
+        value |= (uint64_t)(byte & 0x7f) << shift;
+        if(byte < 0x80) {
+            break;
+        }
+    }
+    return value;
+}
+
+/***
+ * Decode a delta-varint posting list
+ * @param data encoded postings
+ * @param length number of encoded bytes
+ * @param postings decoded document numbers and term frequencies, appended
+ */
+static void decodePostings(const char* data, size_t length, std::vector<std::pair<uint64_t, uint32_t>>& postings) {
+    const char* end = data + length;
+    uint64_t document = 0;
+
+    while(data < end) {
+        document += getVarint(data, end);
+        postings.emplace_back(document, (uint32_t)getVarint(data, end));
+    }
+}
+
+IndexWriter::IndexWriter(const std::string& dir, const std::string& name, size_t segmentLimit)
+        : dir(dir), name(name), segmentLimit(segmentLimit) {
+    std::error_code error;
+    std::filesystem::create_directories(dir, error);
+}
+
+void IndexWriter::add(const std::string& path, const std::string& paragraph, size_t ordinal, std::string_view text) {
+    // term frequencies of this record
+    std::unordered_map<std::string, uint32_t> frequencies;
+    tokenize(text, [&](std::string_view term) {
+        frequencies[std::string(term)]++;
+    });
+
+    uint64_t document;
+    SegmentBuilder* segment;
+    {
+        std::lock_guard<CountingMutex> lock(mutex);
+        document = documents.size();
+        // the merge and migrate tools index paths and titles of older outputs that were never repaired
+        documents.push_back(nlohmann::json{{"path", path}, {"paragraph", paragraph}, {"ordinal", ordinal}}
+                                    .dump(-1, ' ', false, nlohmann::json::error_handler_t::replace));
+
+        // the segment is taken together with the document number, so the numbers of a segment ascend
+        if(idle.empty()) {
+            segments.push_back(std::make_unique<SegmentBuilder>());
+            idle.push_back(segments.back().get());
+        }
+        segment = idle.back();
+        idle.pop_back();
+    }
+
+    // document numbers of a segment ascend, so its posting lists are encoded as deltas right away
+    for(auto& frequency: frequencies) {
+        auto found = segment->terms.find(frequency.first);
+        if(found == segment->terms.end()) {
+            found = segment->terms.emplace(frequency.first, SegmentBuilder::Postings()).first;
+            segment->bytes += found->first.size() + sizeof(SegmentBuilder::Postings);
+        }
+
+        SegmentBuilder::Postings& postings = found->second;
+        size_t before = postings.bytes.size();
+        putVarint(postings.bytes, document - postings.lastDocument);
+        putVarint(postings.bytes, frequency.second);
+        postings.lastDocument = document;
+        postings.documents++;
+        segment->bytes += postings.bytes.size() - before;
+    }
+
+    if(segment->bytes > segmentLimit) {
+        flush(*segment);
+    }
+
+    std::lock_guard<CountingMutex> lock(mutex);
+    idle.push_back(segment);
+}
+
+void IndexWriter::flush(SegmentBuilder& segment) {
+    if(segment.terms.empty()) {
+        return;
+    }
+
+    std::string file;
+    {
+        std::lock_guard<CountingMutex> lock(mutex);
+        file = dir + "/" + name + ".seg" + std::to_string(segmentFiles.size());
+        segmentFiles.push_back(file);
+    }
+
+    std::vector<std::pair<const std::string, SegmentBuilder::Postings>*> sorted;
+    for(auto& term: segment.terms) {
+        sorted.push_back(&term);
+    }
+    std::sort(sorted.begin(), sorted.end(), [](auto* a, auto* b) { return a->first < b->first; });
+
+    // term, number of documents and posting list bytes per entry
+    std::ofstream out(file, std::ofstream::binary | std::ofstream::trunc);
+    std::string header;
+    for(auto* term: sorted) {
+        header.clear();
+        putVarint(header, term->first.size());
+        header.append(term->first);
+        putVarint(header, term->second.documents);
+        putVarint(header, term->second.bytes.size());
+        out.write(header.data(), (std::streamsize)header.size());
+        out.write(term->second.bytes.data(), (std::streamsize)term->second.bytes.size());
+    }
+
+    segment.terms.clear();
+    segment.bytes = 0;
+}
+
+/***
+ * Sequential reader of a segment file mapped into memory during the merge, pages are read on demand, so the merge
+ * does not hold all segments in memory
+ */
+struct SegmentReader {
+    const char* data = nullptr;
+    size_t size = 0;
+    const char* pos = nullptr;
+    const char* end = nullptr;
+
+    std::string term;
+    const char* postings = nullptr;
+    size_t postingsLength = 0;
+
+    /***
+     * Map a segment file
+     * @param file segment file
+     */
+    explicit SegmentReader(const std::string& file) {
+        int fd = open(file.c_str(), O_RDONLY);
+        if(fd < 0) {
+            return;
+        }
+
+        struct stat info{};
+        if(fstat(fd, &info) == 0 && info.st_size > 0) {
+            void* mapping = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if(mapping != MAP_FAILED) {
+                madvise(mapping, info.st_size, MADV_SEQUENTIAL);
+                data = (const char*)mapping;
+                size = info.st_size;
+            }
+        }
+        close(fd);
+
+        pos = data;
+        end = data + size;
+    }
+
+    ~SegmentReader() {
+        if(data != nullptr) {
+            munmap((void*)data, size);
+        }
+    }
+
+    SegmentReader(const SegmentReader&) = delete;
+    SegmentReader& operator=(const SegmentReader&) = delete;
+
+    /***
+     * Advance to the next term
+     * @return false at the end of the segment
+     */
+    bool next() {
+        if(pos >= end) {
+            return false;
+        }
+
+        size_t length = getVarint(pos, end);
+        term.assign(pos, std::min<size_t>(length, end - pos));
+        pos += term.size();
+        getVarint(pos, end);
+        postingsLength = std::min<size_t>(getVarint(pos, end), end - pos);
+        postings = pos;
+        pos += postingsLength;
+        return true;
+    }
+};
+
+bool IndexWriter::finish() {
+    StageScope scope(Stage::Index);
+    for(auto& segment: segments) {
+        flush(*segment);
+    }
+    segments.clear();
+    idle.clear();
+
+    std::vector<std::unique_ptr<SegmentReader>> readers;
+    for(const std::string& file: segmentFiles) {
+        auto reader = std::make_unique<SegmentReader>(file);
+        if(reader->next()) {
+            readers.push_back(std::move(reader));
+        }
+    }
+
+    std::string file = dir + "/" + name;
+    std::string temporary = file + ".tmp";
+    std::ofstream out(temporary, std::ofstream::binary | std::ofstream::trunc);
+    if(!out) {
+        return false;
+    }
+
+    IndexHeader header{};
+    std::memcpy(header.magic, indexMagic, sizeof(indexMagic));
+    out.write((const char*)&header, sizeof(header));
+    uint64_t offset = sizeof(header);
+
+    // k-way merge of the sorted segments by term
+    auto later = [](const SegmentReader* a, const SegmentReader* b) { return a->term > b->term; };
+    std::priority_queue<SegmentReader*, std::vector<SegmentReader*>, decltype(later)> heap(later);
+    for(auto& reader: readers) {
+        heap.push(reader.get());
+    }
+
+    std::vector<TermEntry> terms;
+    std::string termPool;
+    std::vector<std::pair<uint64_t, uint32_t>> postings;
+    std::string encoded;
+
+    while(!heap.empty()) {
+        std::string term = heap.top()->term;
+        postings.clear();
+
+        while(!heap.empty() && heap.top()->term == term) {
+            SegmentReader* reader = heap.top();
+            heap.pop();
+            decodePostings(reader->postings, reader->postingsLength, postings);
+            if(reader->next()) {
+                heap.push(reader);
+            }
+        }
+
+        // segments of different workers interleave their document numbers
+        std::sort(postings.begin(), postings.end());
+
+        encoded.clear();
+        uint64_t last = 0;
+        for(auto& posting: postings) {
+            putVarint(encoded, posting.first - last);
+            putVarint(encoded, posting.second);
+            last = posting.first;
+        }
+        out.write(encoded.data(), (std::streamsize)encoded.size());
+
+        terms.push_back({termPool.size(), (uint32_t)term.size(), (uint32_t)postings.size(), offset, encoded.size()});
+        termPool.append(term);
+        offset += encoded.size();
+    }
+
+    // term strings, then the fixed-size term table aligned for direct access through the mapping
+    uint64_t termPoolOffset = offset;
+    out.write(termPool.data(), (std::streamsize)termPool.size());
+    offset += termPool.size();
+    for(TermEntry& entry: terms) {
+        entry.term += termPoolOffset;
+    }
+
+    uint64_t padding = (8 - offset % 8) % 8;
+    out.write("\0\0\0\0\0\0\0", (std::streamsize)padding);
+    offset += padding;
+
+    header.terms = terms.size();
+    header.termTable = offset;
+    out.write((const char*)terms.data(), (std::streamsize)(terms.size() * sizeof(TermEntry)));
+    offset += terms.size() * sizeof(TermEntry);
+
+    std::vector<DocumentEntry> table;
+    for(const std::string& document: documents) {
+        table.push_back({offset, document.size()});
+        out.write(document.data(), (std::streamsize)document.size());
+        offset += document.size();
+    }
+
+    padding = (8 - offset % 8) % 8;
+    out.write("\0\0\0\0\0\0\0", (std::streamsize)padding);
+    offset += padding;
+
+    header.documents = documents.size();
+    header.documentTable = offset;
+    out.write((const char*)table.data(), (std::streamsize)(table.size() * sizeof(DocumentEntry)));
+
+    out.seekp(0);
+    out.write((const char*)&header, sizeof(header));
+    out.close();
+    if(!out) {
+        return false;
+    }
+
+    std::error_code error;
+    for(const std::string& segment: segmentFiles) {
+        std::filesystem::remove(segment, error);
+    }
+    std::filesystem::rename(temporary, file, error);
+    return !error;
+}
+
+IndexReader::IndexReader(const std::string& path) {
+    int fd = open(path.c_str(), O_RDONLY);
+    if(fd < 0) {
+        return;
+    }
+
+    struct stat info{};
+    if(fstat(fd, &info) == 0 && (size_t)info.st_size >= sizeof(IndexHeader)) {
+        void* mapping = mmap(nullptr, info.st_size, PROT_READ, MAP_SHARED, fd, 0);
+        if(mapping != MAP_FAILED) {
+            data = (const char*)mapping;
+            size = info.st_size;
+        }
+    }
+    close(fd);
+
+    if(data != nullptr) {
+        header = (const IndexHeader*)data;
+        if(std::memcmp(header->magic, indexMagic, sizeof(indexMagic)) != 0 ||
+           header->termTable + header->terms * sizeof(TermEntry) > size ||
+           header->documentTable + header->documents * sizeof(DocumentEntry) > size) {
+            header = nullptr;
+        }
+    }
+}
+
+IndexReader::~IndexReader() {
+    if(data != nullptr) {
+        munmap((void*)data, size);
+    }
+}
+
+bool IndexReader::valid() const {
+    return header != nullptr;
+}
+
+uint64_t IndexReader::documentCount() const {
+    return header != nullptr ? header->documents : 0;
+}
+
+bool IndexReader::lookup(std::string_view term, std::vector<std::pair<uint64_t, uint32_t>>& postings) const {
+    postings.clear();
+    if(header == nullptr) {
+        return false;
+    }
+
+    // binary search in the sorted term table
+    const TermEntry* first = (const TermEntry*)(data + header->termTable);
+    const TermEntry* last = first + header->terms;
+    auto text = [&](const TermEntry& entry) { return std::string_view(data + entry.term, entry.termLength); };
+
+    const TermEntry* found = std::lower_bound(first, last, term, [&](const TermEntry& entry, std::string_view value) {
+        return text(entry) < value;
+    });
+    if(found == last || text(*found) != term) {
+        return false;
+    }
+
+    postings.reserve(found->documents);
+    decodePostings(data + found->postings, found->postingsLength, postings);
+    return true;
+}
+
+std::string_view IndexReader::document(uint64_t document) const {
+    if(header == nullptr || document >= header->documents) {
+        return {};
+    }
+
+    const DocumentEntry& entry = ((const DocumentEntry*)(data + header->documentTable))[document];
+    return {data + entry.offset, entry.length};
+}
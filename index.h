@@ -0,0 +1,160 @@
+#ifndef PDF2TEXT_INDEX_H
+#define PDF2TEXT_INDEX_H
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include "lock_stats.h"
+
+/***
+ * Split a text into lowercase index terms, bytes of UTF-8 sequences are term characters
+ * @param text section text
+ * @param visitor called for every term
+ */
+void tokenize(std::string_view text, const std::function<void(std::string_view)>& visitor);
+
+/***
+ * In-memory posting lists of one worker, flushed as a sorted segment file
+ */
+struct SegmentBuilder {
+    struct Postings {
+        uint64_t lastDocument = 0;
+        uint32_t documents = 0;
+        // delta-varint encoded document numbers and term frequencies
+        std::string bytes;
+    };
+
+    std::unordered_map<std::string, Postings> terms;
+    size_t bytes = 0;
+};
+
+/***
+ * Inverted index writer fed during conversion, every record is added to an idle segment which is merged by finish()
+ */
+class IndexWriter {
+public:
+    /***
+     * Create an index writer, segments are written next to the index
+     * @param dir index directory, created if missing
+     * @param name file name of the merged index
+     * @param segmentLimit bytes of posting lists a segment keeps in memory before it is flushed
+     */
+    IndexWriter(const std::string& dir, const std::string& name, size_t segmentLimit = 64 << 20);
+
+    /***
+     * Index a written record
+     * @param path input path
+     * @param paragraph section title
+     * @param ordinal record number within the section
+     * @param text record text
+     */
+    void add(const std::string& path, const std::string& paragraph, size_t ordinal, std::string_view text);
+
+    /***
+     * Flush all segments and merge them into the index
+     * @return false if the index could not be written
+     */
+    bool finish();
+
+private:
+    /***
+     * Write the posting lists of a segment as sorted segment file and clear them
+     * @param segment posting lists
+     */
+    void flush(SegmentBuilder& segment);
+
+    std::string dir;
+    std::string name;
+    size_t segmentLimit;
+
+    CountingMutex mutex{"index_writer"};
+    // document metadata by document number
+    std::vector<std::string> documents;
+    // one segment per concurrent add(), threads of finished queue batches leave no segment behind
+    std::vector<std::unique_ptr<SegmentBuilder>> segments;
+    std::vector<SegmentBuilder*> idle;
+    std::vector<std::string> segmentFiles;
+};
+
+/***
+ * Header of a merged index file, all numbers in native byte order
+ */
+struct IndexHeader {
+    char magic[8];
+    uint64_t terms;
+    uint64_t documents;
+    // file offsets of the tables
+    uint64_t termTable;
+    uint64_t documentTable;
+};
+
+/***
+ * Term table entry, sorted by term for binary search
+ */
+struct TermEntry {
+    uint64_t term;
+    uint32_t termLength;
+    uint32_t documents;
+    uint64_t postings;
+    uint64_t postingsLength;
+};
+
+/***
+ * Document table entry, locates the JSON metadata of a document
+ */
+struct DocumentEntry {
+    uint64_t offset;
+    uint64_t length;
+};
+
+/***
+ * Read-only view of a merged index file mapped into memory
+ */
+class IndexReader {
+public:
+    /***
+     * Map an index file
+     * @param path index file
+     */
+    explicit IndexReader(const std::string& path);
+    ~IndexReader();
+
+    /***
+     * Check if the file was mapped and has a valid header
+     * @return true if the index can be queried
+     */
+    bool valid() const;
+
+    /***
+     * Get the number of indexed documents
+     * @return number of documents
+     */
+    uint64_t documentCount() const;
+
+    /***
+     * Get the posting list of a term
+     * @param term index term
+     * @param postings document numbers and term frequencies in ascending document order
+     * @return false if the term is not indexed
+     */
+    bool lookup(std::string_view term, std::vector<std::pair<uint64_t, uint32_t>>& postings) const;
+
+    /***
+     * Get the metadata of a document
+     * @param document document number
+     * @return JSON object with path, paragraph and ordinal
+     */
+    std::string_view document(uint64_t document) const;
+
+private:
+    const char* data = nullptr;
+    size_t size = 0;
+    const IndexHeader* header = nullptr;
+};
+
+#endif //PDF2TEXT_INDEX_H
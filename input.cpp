@@ -0,0 +1,114 @@
+#include "input.h"
+
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include "archive.h"
+#include "utf8.h"
+
+/***
+ * Collect all files of a directory and its subdirectories in sorted order
+ * @param dir current directory
+ * @param root command line root of the directory
+ * @param inputs list of all inputs
+ */
+static void collectDirectory(const std::filesystem::path& dir, const std::filesystem::path& root,
+                             std::vector<Input>& inputs) {
+    std::vector<std::filesystem::directory_entry> entries;
+    for(auto& entry: std::filesystem::directory_iterator(dir)) {
+        entries.push_back(entry);
+    }
+
+    // directory order differs between file systems
+    std::sort(entries.begin(), entries.end());
+
+    for(auto& entry: entries) {
+        if(entry.is_directory()) {
+            collectDirectory(entry.path(), root, inputs);
+        }
+        else {
+            Input input;
+            input.path = entry.path().string();
+            input.relative = std::filesystem::relative(entry.path(), root).generic_string();
+            input.topic = entry.path().filename().string();
+
+            // file names are bytes, the output names need valid UTF-8, the path still opens the file
+            repairUTF8(input.relative);
+            repairUTF8(input.topic);
+            inputs.push_back(input);
+        }
+    }
+}
+
+std::vector<Input> collectInputs(const std::vector<std::string>& paths) {
+    std::vector<Input> inputs;
+
+    for(const std::string& path: paths) {
+        if(path != "-" && std::filesystem::is_directory(path)) {
+            collectDirectory(path, path, inputs);
+        }
+        else {
+            Input input;
+            input.path = path;
+            input.relative = path == "-" ? "stdin" : std::filesystem::path(path).filename().string();
+            input.topic = path.substr(path.find_last_of('/') + 1);
+            repairUTF8(input.relative);
+            repairUTF8(input.topic);
+            inputs.push_back(input);
+        }
+    }
+
+    for(size_t i = 0; i < inputs.size(); i++) {
+        inputs[i].seq = i;
+    }
+    return inputs;
+}
+
+Input memberInput(const Input& container, const std::string& member, size_t index) {
+    Input input;
+    input.path = (container.path == "-" ? "stdin" : container.path) + ":" + member;
+    input.relative = container.relative + ":" + member;
+    input.topic = member;
+    repairUTF8(input.relative);
+    repairUTF8(input.topic);
+    input.seq = container.seq;
+    input.member = index;
+    input.interactive = container.interactive;
+    return input;
+}
+
+bool expandInput(const Input& input, const InputVisitor& visitor, const SkipVisitor& skipped) {
+    size_t index = 0;
+    auto visitMember = [&](const std::string& member, std::vector<char>& data) {
+        visitor(memberInput(input, member, ++index), &data);
+    };
+    // skipped members keep their position, so the numbers of later members do not change
+    ArchiveSkipHandler skipMember = [&](const std::string& member, const std::string& reason) {
+        Input skippedInput = memberInput(input, member, ++index);
+        if(skipped) {
+            skipped(skippedInput, reason);
+        }
+    };
+
+    if(input.path == "-") {
+        // read a PDF or an archive from a pipe
+        return readStdin(visitMember, skipMember);
+    }
+    if(isArchive(input.path)) {
+        return readArchive(input.path, visitMember, skipMember);
+    }
+
+    visitor(input, nullptr);
+    return true;
+}
+
+bool readFile(const std::string& path, std::vector<char>& data) {
+    std::ifstream in(path, std::ifstream::binary | std::ifstream::ate);
+    if(!in) {
+        return false;
+    }
+
+    data.resize((size_t)in.tellg());
+    in.seekg(0);
+    return (bool)in.read(data.data(), (std::streamsize)data.size());
+}
@@ -0,0 +1,73 @@
+#ifndef PDF2TEXT_INPUT_H
+#define PDF2TEXT_INPUT_H
+
+#include <functional>
+#include <string>
+#include <vector>
+
+/***
+ * A PDF file, archive member or stdin stream to convert
+ */
+struct Input {
+    // file system path, archive members are named "archive:member", "-" is stdin
+    std::string path;
+    // path relative to its command line root, stable across machines
+    std::string relative;
+    // topic of all sections
+    std::string topic;
+    // position in the sorted list of all command line inputs
+    size_t seq = 0;
+    // 1-based position inside an archive, 0 for plain files
+    size_t member = 0;
+    // scheduled ahead of bulk inputs
+    bool interactive = false;
+};
+
+/***
+ * Collect all inputs of the given paths in a stable order
+ * @param paths directories, PDF files, archives or "-" for stdin
+ * @return inputs with ascending sequence numbers
+ */
+std::vector<Input> collectInputs(const std::vector<std::string>& paths);
+
+/***
+ * Create the input for a member of an archive or stdin stream, inheriting its priority
+ * @param container archive or stdin input
+ * @param member member path
+ * @param index 1-based member position
+ * @return member input sharing the container's sequence number
+ */
+Input memberInput(const Input& container, const std::string& member, size_t index);
+
+/***
+ * Callback for a PDF to convert
+ * @param input plain file or archive member
+ * @param data in-memory PDF content, nullptr for plain files
+ */
+using InputVisitor = std::function<void(const Input& input, std::vector<char>* data)>;
+
+/***
+ * Callback for an archive member that cannot be read
+ * @param input archive member
+ * @param reason reason for skipping the member
+ */
+using SkipVisitor = std::function<void(const Input& input, const std::string& reason)>;
+
+/***
+ * Visit a plain file or every member of an archive or stdin input
+ * @param input command line input
+ * @param visitor callback for every PDF
+ * @param skipped callback for corrupt archive members, nullptr to leave them out silently
+ * @return false if an archive could not be read
+ */
+bool expandInput(const Input& input, const InputVisitor& visitor, const SkipVisitor& skipped = nullptr);
+
+/***
+ * Read a whole file into memory
+ * @param path file path
+ * @param data file content
+ * @return false if the file could not be read
+ */
+bool readFile(const std::string& path, std::vector<char>& data);
+
+#endif //PDF2TEXT_INPUT_H
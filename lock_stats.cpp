@@ -0,0 +1,73 @@
+#include "lock_stats.h"
+
+#include <chrono>
+#include <map>
+#include <memory>
+#include <string>
+
+/***
+ * Get the registry of counters by mutex name, counters live until the process exits
+ * @param lock held while the registry is used
+ * @return counters by name
+ */
+static std::map<std::string, std::unique_ptr<LockStats>>& registry(std::unique_lock<std::mutex>& lock) {
+    static std::mutex mutex;
+    static std::map<std::string, std::unique_ptr<LockStats>> stats;
+    lock = std::unique_lock<std::mutex>(mutex);
+    return stats;
+}
+
+CountingMutex::CountingMutex(const char* name) {
+    std::unique_lock<std::mutex> lock;
+    std::unique_ptr<LockStats>& entry = registry(lock)[name];
+    if(entry == nullptr) {
+        entry = std::make_unique<LockStats>();
+    }
+    stats = entry.get();
+}
+
+void CountingMutex::lock() {
+    stats->acquisitions.fetch_add(1, std::memory_order_relaxed);
+
+    // the uncontended path costs a single try_lock
+    if(mutex.try_lock()) {
+        return;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    mutex.lock();
+    auto waited = std::chrono::steady_clock::now() - start;
+
+    stats->contended.fetch_add(1, std::memory_order_relaxed);
+    stats->waitNanos.fetch_add(std::chrono::duration_cast<std::chrono::nanoseconds>(waited).count(),
+                               std::memory_order_relaxed);
+}
+
+bool CountingMutex::try_lock() {
+    if(!mutex.try_lock()) {
+        return false;
+    }
+    stats->acquisitions.fetch_add(1, std::memory_order_relaxed);
+    return true;
+}
+
+void CountingMutex::unlock() {
+    mutex.unlock();
+}
+
+nlohmann::json lockMetrics() {
+    std::unique_lock<std::mutex> lock;
+    nlohmann::json metrics = nlohmann::json::object();
+
+    for(auto& entry: registry(lock)) {
+        uint64_t acquisitions = entry.second->acquisitions;
+        uint64_t contended = entry.second->contended;
+        metrics[entry.first] = {
+                {"acquisitions", acquisitions},
+                {"contended", contended},
+                {"contention_rate", acquisitions > 0 ? (double)contended / (double)acquisitions : 0.0},
+                {"wait_ms", (double)entry.second->waitNanos / 1e6}
+        };
+    }
+    return metrics;
+}
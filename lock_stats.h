@@ -0,0 +1,46 @@
+#ifndef PDF2TEXT_LOCK_STATS_H
+#define PDF2TEXT_LOCK_STATS_H
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include "include/nlohmann/json.hpp"
+
+/***
+ * Contention counters of all mutexes with the same name
+ */
+struct LockStats {
+    std::atomic<uint64_t> acquisitions{0};
+    // acquisitions that had to wait for another thread
+    std::atomic<uint64_t> contended{0};
+    std::atomic<uint64_t> waitNanos{0};
+};
+
+/***
+ * Mutex counting how often and how long threads wait for it, usable with std::lock_guard, std::unique_lock and
+ * std::condition_variable_any
+ */
+class CountingMutex {
+public:
+    /***
+     * Create a mutex
+     * @param name name in the metrics report, mutexes of the same name share their counters
+     */
+    explicit CountingMutex(const char* name);
+
+    void lock();
+    bool try_lock();
+    void unlock();
+
+private:
+    std::mutex mutex;
+    LockStats* stats;
+};
+
+/***
+ * Get the contention counters of all named mutexes for the metrics report
+ * @return metrics as JSON object by mutex name
+ */
+nlohmann::json lockMetrics();
+
+#endif //PDF2TEXT_LOCK_STATS_H
@@ -0,0 +1,161 @@
+#include "lz.h"
+
+#include <algorithm>
+#include <bit>
+#include <cstring>
+#include <vector>
+#include "hash.h"
+
+// LZ4 block format limits
+static const size_t minMatch = 4;
+static const size_t lastLiterals = 5;
+static const size_t matchSearchLimit = 12;
+static const size_t maxOffset = 65535;
+static const int maxHashBits = 16;
+static const int minHashBits = 10;
+
+/***
+ * Append a length continuation after a 15 in a token nibble
+ * @param out compressed block
+ * @param length remaining length
+ */
+static void putLength(std::string& out, size_t length) {
+    for(; length >= 255; length -= 255) {
+        out.push_back((char)255);
+    }
+    out.push_back((char)length);
+}
+
+/***
+ * Append a sequence of literals and an optional match
+ * @param out compressed block
+ * @param literals literal bytes
+ * @param offset distance of the match, 0 for the last literals
+ * @param match match length
+ */
+static void putSequence(std::string& out, std::string_view literals, size_t offset, size_t match) {
+    size_t matchCode = offset > 0 ? match - minMatch : 0;
+    out.push_back((char)((std::min<size_t>(literals.size(), 15) << 4) | std::min<size_t>(matchCode, 15)));
+
+    if(literals.size() >= 15) {
+        putLength(out, literals.size() - 15);
+    }
+    out.append(literals);
+
+    if(offset > 0) {
+        out.push_back((char)(offset & 0xff));
+        out.push_back((char)(offset >> 8));
+        if(matchCode >= 15) {
+            putLength(out, matchCode - 15);
+        }
+    }
+}
+
+std::string lzCompress(std::string_view text) {
+    std::string out;
+    out.reserve(text.size() / 2 + 16);
+
+    size_t anchor = 0;
+    if(text.size() > matchSearchLimit) {
+        // positions + 1 of the last occurrence of 4 byte sequences, 0 is empty, the table is kept per thread and
+        // sized to the text like in LZ4, so a page does not pay for clearing 256 KiB
+        static thread_local std::vector<uint32_t> table(1 << maxHashBits);
+        int hashBits = std::clamp((int)std::bit_width(text.size()), minHashBits, maxHashBits);
+        std::fill_n(table.begin(), 1 << hashBits, 0);
+        size_t limit = text.size() - matchSearchLimit;
+
+        for(size_t pos = 0; pos < limit;) {
+            uint32_t sequence = readWord32(text.data() + pos);
+            uint32_t hash = (sequence * 2654435761u) >> (32 - hashBits);
+            size_t candidate = table[hash];
+            table[hash] = (uint32_t)pos + 1;
+
+            if(candidate == 0 || pos - (candidate - 1) > maxOffset ||
+               readWord32(text.data() + candidate - 1) != sequence) {
+                pos++;
+                continue;
+            }
+
+            size_t ref = candidate - 1;
+            size_t length = minMatch;
+            while(pos + length < text.size() - lastLiterals && text[ref + length] == text[pos + length]) {
+                length++;
+            }
+
+            putSequence(out, text.substr(anchor, pos - anchor), pos - ref, length);
+            pos += length;
+            anchor = pos;
+        }
+    }
+
+    putSequence(out, text.substr(anchor), 0, 0);
+    return out;
+}
+
+/***
+ * Read a length continuation
+ * @param data compressed bytes, advanced past the length
+ * @param end end of the block
+ * @param length length with the nibble value 15, extended in place
+ * @return false if the block ends within the length
+ */
+static bool getLength(const unsigned char*& data, const unsigned char* end, size_t& length) {
+    unsigned char byte;
+    do {
+        if(data >= end) {
+            return false;
+        }
+        byte = *data++;
+        length += byte;
+    } while(byte == 255);
+    return true;
+}
+
+bool lzDecompress(std::string_view block, size_t size, std::string& text) {
+    text.resize(size);
+    const unsigned char* data = (const unsigned char*)block.data();
+    const unsigned char* end = data + block.size();
+    size_t pos = 0;
+
+    while(data < end) {
+        unsigned char token = *data++;
+
+        size_t literals = token >> 4;
+        if(literals == 15 && !getLength(data, end, literals)) {
+            return false;
+        }
+        if(literals > (size_t)(end - data) || literals > size - pos) {
+            return false;
+        }
+        std::memcpy(&text[pos], data, literals);
+        data += literals;
+        pos += literals;
+
+        // the last sequence has no match
+        if(data >= end) {
+            break;
+        }
+
+        if(end - data < 2) {
+            return false;
+        }
+        size_t offset = data[0] | (size_t)data[1] << 8;
+        data += 2;
+
+        size_t match = token & 15;
+        if(match == 15 && !getLength(data, end, match)) {
+            return false;
+        }
+        match += minMatch;
+
+        if(offset == 0 || offset > pos || match > size - pos) {
+            return false;
+        }
+
+        // overlapping matches repeat the bytes just written
+        for(size_t i = 0; i < match; i++, pos++) {
+            text[pos] = text[pos - offset];
+        }
+    }
+    return pos == size;
+}
@@ -0,0 +1,23 @@
+#ifndef PDF2TEXT_LZ_H
+#define PDF2TEXT_LZ_H
+
+#include <string>
+#include <string_view>
+
+/***
+ * Compress a text into an LZ4 block, greedy matching with a 64 KiB window
+ * @param text uncompressed text
+ * @return compressed block
+ */
+std::string lzCompress(std::string_view text);
+
+/***
+ * Decompress an LZ4 block
+ * @param block compressed block
+ * @param size uncompressed size
+ * @param text uncompressed text
+ * @return false if the block is corrupt
+ */
+bool lzDecompress(std::string_view block, size_t size, std::string& text);
+
+#endif //PDF2TEXT_LZ_H
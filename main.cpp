@@ -1,275 +1,469 @@
+#include <algorithm>
 #include <iostream>
 #include <filesystem>
 #include <fstream>
-#include <stack>
-#include <queue>
+#include <memory>
 #include <string>
-#include <poppler/cpp/poppler-document.h>
-#include <poppler/cpp/poppler-toc.h>
-#include <poppler/cpp/poppler-page.h>
-#include <regex>
+#include <thread>
+#include <boost/program_options.hpp>
 #include "include/nlohmann/json.hpp"
+#include "alloc_stats.h"
+#include "concurrency.h"
+#include "converter.h"
+#include "input.h"
+#include "output.h"
+#include "perf_counters.h"
+#include "profiler.h"
+#include "queue.h"
+#include "result_cache.h"
+#include "scheduler.h"
+#include "shard.h"
+#include "sweep.h"
+#include "topology.h"
+#include "utf8.h"
 
 /***
- * Get Levenshtein distance of 2 strings
- * @param s1 first string
- * @param s2 second string
- * @return Levenshtein distance of both strings
+ * Convert inputs on a pool of worker threads while the calling thread reads files and archives
+ * @param inputs inputs to convert
+ * @param shard shard of this process
+ * @param conversion conversion options
+ * @param writer output for sections and skipped files
+ * @param controller concurrency gate of the workers
+ * @param numa topology to pin workers to NUMA nodes, nullptr to let the scheduler place them
+ * @param window number of documents waiting for a worker, reordered by priority and size
+ * @param agingRate pages a waiting document gains per second of waiting
+ * @param cache result cache, nullptr to convert every document
+ * @param documents cache of opened documents, nullptr to open every document
  */
-unsigned int distance(const std::string& s1, const std::string& s2)
-{
-    const std::size_t len1 = s1.size(), len2 = s2.size();
-    std::vector<std::vector<unsigned int>> d(len1 + 1, std::vector<unsigned int>(len2 + 1));
-
-    d[0][0] = 0;
-    for(unsigned int i = 1; i <= len1; ++i) d[i][0] = i;
-    for(unsigned int i = 1; i <= len2; ++i) d[0][i] = i;
-
-    for(unsigned int i = 1; i <= len1; ++i) {
-        for(unsigned int j = 1; j <= len2; ++j) {
-            d[i][j] = std::min({d[i - 1][j] + 1, d[i][j - 1] + 1, d[i - 1][j - 1] + (s1[i - 1] == s2[j - 1] ? 0 : 1)});
-        }
-    }
-    return d[len1][len2];
-}
-
-/***
- * Extract the text of a PDF page into sections
- * @param sections list for all section titles
- * @param sectionTexts list of all sections
- * @param content PDF page content
- * @param usedSections list of already processed sections
- */
-void extractText(std::stack<std::string>& sections, std::vector<std::string>& sectionTexts,
-                 std::string content, std::queue<std::string>& usedSections) {
-    // run until the full page has been processed
-    do {
-        std::string separator;
-
-        // there are sections available for extraction
-        if(!sections.empty()) {
-            // get first section from stack
-            separator = sections.top();
-        }
-        else {
-            return;
-        }
-
-        // similarity threshold for section title detection
-        float threshold = std::round((float)separator.length() * 0.1f);
-
-        std::string first_segment;
-
-        // Levenshtein distance of section title and page content and title position
-        unsigned int dist = -1;
-        int pos = 0;
-
-        // iterate over page from bottom to top
-        for(int i = (int)content.size() - (int)separator.size(); i >= (int)separator.size(); i--) {
-            unsigned int dist_before = dist;
+void convertInputs(const std::vector<Input>& inputs, const Shard& shard, const ConversionOptions& conversion,
+                   OutputWriter& writer, ConcurrencyController& controller, const Topology* numa,
+                   size_t window, double agingRate, ResultCache* cache, DocumentCache* documents) {
+    // one task queue per NUMA node, so documents stay on the node of the worker that allocates their pages
+    size_t nodes = numa != nullptr ? numa->nodes.size() : 1;
+    Scheduler scheduler(nodes, window, agingRate);
+
+    std::vector<std::thread> workers;
+    for(size_t w = 0; w < controller.workers(); w++) {
+        workers.emplace_back([&, w]() {
+            size_t node = w % nodes;
+            if(numa != nullptr) {
+                pinToNode(numa->nodes[node]);
+            }
 
-            // select substring with current section title's length
-            std::string substring = content.substr(i - separator.size(), separator.size());
+            Task task;
+            while(scheduler.pop(task, node)) {
+                controller.acquire();
+
+                // repeated documents are served from the cache with a single write
+                if(cache != nullptr && task.conversion == nullptr) {
+                    if(task.data == nullptr) {
+                        StageScope reading(Stage::Read);
+                        task.data = std::make_shared<std::vector<char>>();
+                        if(!readFile(task.input.path, *task.data)) {
+                            task.data.reset();
+                        }
+                        else {
+                            addStageBytes(Stage::Read, task.data->size());
+                        }
+                    }
+
+                    CachedResult cached;
+                    if(task.data != nullptr) {
+                        task.cacheKey = cache->key(*task.data);
+                        if(cache->get(task.cacheKey, task.input.topic, cached)) {
+                            // the key starts with the content hash
+                            writer.write(task.input, cached.line, cached.sections, cached.repairs,
+                                         task.cacheKey.substr(0, 16));
+                            controller.release(0);
+                            continue;
+                        }
+                    }
+                }
+
+                if(task.conversion == nullptr) {
+                    task.conversion = startConversion(task.input, task.data, conversion, writer, documents);
+                }
+                if(task.conversion == nullptr) {
+                    controller.release(0);
+                    continue;
+                }
+
+                // large bulk documents yield to waiting interactive documents at page boundaries
+                int firstPage = task.conversion->nextPage;
+                bool finished = convertPages(*task.conversion, conversion, [&]() {
+                    task.pages = task.conversion->nextPage + 1;
+                    return scheduler.shouldPreempt(task, node);
+                });
+                size_t pages = firstPage - task.conversion->nextPage;
+
+                if(finished) {
+                    std::vector<std::string> output = finishConversion(*task.conversion, task.input, conversion,
+                                                                       writer);
+                    if(cache != nullptr && !task.cacheKey.empty()) {
+                        CachedResult result{task.input.topic, "", task.conversion->sectionCount,
+                                            task.conversion->repairs};
+                        for(const std::string& chunk: output) {
+                            result.line += chunk;
+                        }
+                        cache->put(task.cacheKey, result);
+                    }
+                    controller.release(pages);
+                }
+                else {
+                    controller.release(pages, false);
+                    scheduler.requeue(std::move(task), node);
+                }
+                task = Task();
+            }
+        });
+    }
 
-            // calculate Levenshtein distance
-            dist = std::min(dist, distance(substring, separator));
+    // page counts only order the window when interactive documents compete with bulk documents
+    bool prioritize = std::any_of(inputs.begin(), inputs.end(), [](const Input& input) { return input.interactive; });
 
-            // distance decreased
-            if(dist != dist_before) {
-                // update position
-                pos = i - (int) separator.size();
+    StageScope reading(Stage::Read);
+    for(const Input& input: inputs) {
+        bool complete = expandInput(input, [&](const Input& file, std::vector<char>* data) {
+            if(!inShard(file, shard)) {
+                return;
             }
 
-            // stop, if exact match found
-            if(dist == 0) {
-                break;
+            // the page count of a quick open is the expected job size
+            Task task;
+            task.input = file;
+            task.data = data != nullptr ? std::make_shared<std::vector<char>>(std::move(*data)) : nullptr;
+            task.pages = prioritize ? countPages(file, task.data.get()) : 0;
+            addStageBytes(Stage::Read, task.data != nullptr ? task.data->size() : 0);
+            scheduler.push(std::move(task));
+        }, [&](const Input& file, const std::string& reason) {
+            if(inShard(file, shard)) {
+                writer.skip(file, reason);
             }
-        }
+        });
 
-        // shift start position of section to the left if section starts with special unicode characters
-        while(pos > 0 && char(content[pos]) < 0) {
-            pos--;
+        if(!complete && inShard(input, shard)) {
+            writer.skip(input, "unreadable archive");
         }
+    }
 
-        // section title not found
-        if((float)dist > threshold) {
-            // select full remaining content
-            first_segment = content;
-        }
-        else {
-            // select content after section title
-            first_segment = content.substr(pos);
-        }
-
-        // append segment to the last found section
-        sectionTexts.back().append(first_segment);
-
-        // section title found
-        if((float)dist <= threshold) {
-            // select remaining content
-            content = content.substr(0, pos);
-
-            // create new section and move to next title
-            sections.pop();
-            sectionTexts.emplace_back("");
-
-            // store title of finished section
-            usedSections.push(separator);
-        }
-        else {
-            break;
-        }
-    } while(true);
-}
+    scheduler.close();
 
-/***
- * Convert PDF unicode string to basic UTF-8 string
- * @param text PDF unicode string
- * @return converted basic string
- */
-std::string toUTF8(const poppler::ustring& text) {
-    poppler::byte_array titleArray = text.to_utf8();
-    return std::string { titleArray.data(), titleArray.size() };
+    for(std::thread& worker: workers) {
+        worker.join();
+    }
 }
 
 /***
- * Read the table of contents of a PDF file
- * @param tocStack list of all section titles
- * @param tocItem root node of ToC tree
+ * run PDF section to JSON conversion for all files in all given directories
+ * @param argc list of arguments
+ * @param argv options + language tag + list of directories, PDF files or archives, "-" reads from stdin
+ * @return status code
  */
-void loadTOC(std::stack<std::string>& tocStack, const poppler::toc_item& tocItem) {
-    for(poppler::toc_item* section: tocItem.children()) {
-        std::string label = toUTF8(section->title());
-
-        // remove multiple white spaces
-        std::regex space_re(R"(\s+)");
-        label = std::regex_replace(label, space_re, " ");
-
-        tocStack.push(label);
+int main(int argc, char **argv) {
+    namespace po = boost::program_options;
+
+    po::options_description visible("Options");
+    visible.add_options()
+            ("help,h", "show this help")
+            ("shard", po::value<std::string>(), "convert only shard i of N, given as i/N")
+            ("plan", po::value<size_t>(), "print files and estimated pages of N shards and exit")
+            ("queue", po::value<std::string>(), "claim batches from a work queue directory shared by all workers")
+            ("batch-size", po::value<size_t>()->default_value(16), "inputs per batch when creating the queue")
+            ("lease-timeout", po::value<unsigned int>()->default_value(60),
+             "seconds without heartbeat until a batch lease expires")
+            ("jobs,j", po::value<size_t>()->default_value(0),
+             "number of worker threads, 0 sizes and adapts them to the CPU quota and memory pressure")
+            ("metrics", po::value<std::string>(), "write concurrency and throughput metrics as JSON to this file")
+            ("numa", "pin workers to NUMA nodes and keep each document on one node")
+            ("interactive", po::value<std::vector<std::string>>()->multitoken(),
+             "paths converted ahead of bulk paths, preempting large bulk documents at page boundaries")
+            ("aging", po::value<double>()->default_value(10),
+             "pages a waiting document gains per second of waiting, prevents starvation")
+            ("schedule-window", po::value<size_t>()->default_value(1024),
+             "documents reordered by priority and expected size")
+            ("cache-memory", po::value<size_t>()->default_value(0), "MiB of converted outputs cached in memory")
+            ("cache-dir", po::value<std::string>(), "directory of the on-disk result cache, shared between runs")
+            ("cache-disk", po::value<size_t>()->default_value(1024), "MiB of converted outputs cached on disk")
+            ("document-cache", po::value<size_t>()->default_value(0),
+             "MiB of opened documents and page texts kept for repeated inputs")
+            ("compress-text", "keep page texts and cached sections LZ4 compressed while they are not matched")
+            ("section", po::value<std::vector<std::string>>(), "extract only sections with this title, repeatable")
+            ("threshold", po::value<float>()->default_value(0.1f, "0.1"),
+             "maximum Levenshtein distance of a section title match relative to the title length")
+            ("paragraphs", "split sections into paragraph records with ordinal numbers")
+            ("chunk-size", po::value<size_t>()->default_value(0),
+             "split sections into chunks of at most N characters at paragraph, sentence or word boundaries")
+            ("chunk-overlap", po::value<size_t>()->default_value(0), "characters repeated between adjacent chunks")
+            ("chunk-tokens", "count chunk size and overlap in approximate tokens of 4 characters")
+            ("dedup", po::value<std::string>(),
+             "flag, suppress or reference sections that are near-duplicates of earlier sections of the run")
+            ("dedup-distance", po::value<unsigned int>()->default_value(5),
+             "maximum differing SimHash bits of near-duplicates, at most 5")
+            ("index", po::value<std::string>(), "build an inverted index of the written records in this directory")
+            ("format", po::value<std::string>()->default_value("json"),
+             "output format, json lines or sqlite with documents and sections tables")
+            ("fts", "build an FTS5 full-text table over the sections of the sqlite output")
+            ("sweep", po::value<std::string>(),
+             "compare comma separated thresholds from a single extraction, writes sweep.json and exits")
+            ("profile", po::value<std::string>(),
+             "sample CPU stacks tagged with the pipeline stage, writes folded stacks for flame graphs to this file")
+            ("profile-rate", po::value<unsigned int>()->default_value(99), "profiler samples per CPU second")
+            ("perf-counters",
+             "count cycles, instructions, cache and branch misses per pipeline stage into the metrics");
+
+    po::options_description hidden;
+    hidden.add_options()
+            ("language", po::value<std::string>())
+            ("paths", po::value<std::vector<std::string>>());
+
+    po::options_description all;
+    all.add(visible).add(hidden);
+
+    po::positional_options_description positional;
+    positional.add("language", 1).add("paths", -1);
+
+    po::variables_map options;
+    try {
+        po::store(po::command_line_parser(argc, argv).options(all).positional(positional).run(), options);
+    }
+    catch(const po::error& error) {
+        std::cout << error.what() << std::endl;
+        return 1;
     }
-}
 
-/***
- * Convert a PDF file into JSON list of sections
- * @param file PDF file path
- * @param language PDF text language
- */
-void convertPDF(const std::string& file, const std::string& language) {
-    // get file name
-    std::string fileName = file.substr(file.find_last_of('/') + 1);
+    if(options.count("help")) {
+        std::cout << "Usage: PDF2Text [options] language paths..." << std::endl << visible << std::endl;
+        return 0;
+    }
 
-    // open PDF and read title
-    poppler::document* document = poppler::document::load_from_file(file);
-    std::string title = toUTF8(document->get_title());
+    // workers joining an existing queue only need the language
+    if(!options.count("language") || (!options.count("paths") && !options.count("interactive") &&
+                                      !options.count("queue"))) {
+        std::cout << "Please enter a language tag and a path to a PDF file" << std::endl;
+        return 0;
+    }
 
-    // table of contents of the PDF
-    poppler::toc* fileTOC = document->create_toc();
+    // sample where the CPU time goes, the folded stacks are written when main returns
+    std::unique_ptr<Profiler> profiler;
+    if(options.count("profile")) {
+        profiler = std::make_unique<Profiler>(options["profile"].as<std::string>(),
+                                              options["profile-rate"].as<unsigned int>());
+    }
 
-    std::stack<std::string> sections = std::stack<std::string>();
+    // restricted containers forbid perf_event_open, the run continues without counters
+    if(options.count("perf-counters") && !startStageCounters()) {
+        std::cout << "Hardware counters are unavailable, see the metrics for the reason" << std::endl;
+    }
 
-    // ToC available
-    if(fileTOC != nullptr) {
-        loadTOC(sections, *fileTOC->root());
+    ConversionOptions conversion;
+    conversion.language = options["language"].as<std::string>();
+    repairUTF8(conversion.language);
+    if(options.count("section")) {
+        conversion.sections = options["section"].as<std::vector<std::string>>();
     }
-    else {
-        // Log unsupported file
-        std::cout << title << std::endl;
-        return;
+    conversion.threshold = options["threshold"].as<float>();
+    conversion.paragraphs = options.count("paragraphs") > 0;
+    conversion.compressText = options.count("compress-text") > 0;
+
+    // chunks are bounded in bytes, tokens are estimated from characters
+    size_t chunkUnit = options.count("chunk-tokens") ? 4 : 1;
+    conversion.chunkSize = options["chunk-size"].as<size_t>() * chunkUnit;
+    conversion.chunkOverlap = options["chunk-overlap"].as<size_t>() * chunkUnit;
+
+    if(options.count("dedup")) {
+        if(!parseDedupMode(options["dedup"].as<std::string>(), conversion.dedup)) {
+            std::cout << "Please enter flag, suppress or reference as dedup mode" << std::endl;
+            return 1;
+        }
+        conversion.duplicates = std::make_shared<DuplicateIndex>(options["dedup-distance"].as<unsigned int>());
+    }
+    std::vector<std::string> paths;
+    if(options.count("paths")) {
+        paths = options["paths"].as<std::vector<std::string>>();
+    }
+
+    // interactive inputs are numbered after the bulk inputs
+    std::vector<std::string> interactivePaths;
+    if(options.count("interactive")) {
+        interactivePaths = options["interactive"].as<std::vector<std::string>>();
+        paths.insert(paths.end(), interactivePaths.begin(), interactivePaths.end());
     }
 
-    std::vector<std::string> sectionTexts{""};
-    std::queue<std::string> usedSections{};
+    std::vector<Input> inputs = collectInputs(paths);
+    size_t interactiveInputs = collectInputs(interactivePaths).size();
+    for(size_t i = inputs.size() - interactiveInputs; i < inputs.size(); i++) {
+        inputs[i].interactive = true;
+    }
 
-    // iterate over all pages from back to front
-    for(int i = document->pages() - 1; i >= 0; i--) {
-        // load page and read text
-        poppler::page* page = document->create_page(i);
-        std::string sectionText = toUTF8(page->text());
+    // size the worker pool to the CPUs this process may use, never oversubscribing a container
+    ResourceLimits limits = detectLimits();
+    size_t jobs = options["jobs"].as<size_t>();
+    size_t workers = jobs > 0 ? jobs : std::max<size_t>(1, (size_t)limits.cpus);
+    ConcurrencyController controller(workers, jobs == 0, limits.memory);
+    conversion.controller = &controller;
 
-        // remove multiple whitespaces
-        std::regex space_re(R"(\s+)");
-        sectionText = std::regex_replace(sectionText, space_re, " ");
+    // pinning only pays off with more than one node, single-node machines keep unpinned workers
+    Topology topology = readTopology();
+    const Topology* numa = options.count("numa") && topology.nodes.size() > 1 ? &topology : nullptr;
 
-        // find sections in page text
-        extractText(sections, sectionTexts, sectionText, usedSections);
+    size_t window = options["schedule-window"].as<size_t>();
+    double agingRate = options["aging"].as<double>();
 
-        delete page;
+    std::string format = options["format"].as<std::string>();
+    if(format != "json" && format != "sqlite") {
+        std::cout << "Please enter json or sqlite as output format" << std::endl;
+        return 1;
     }
 
-    delete document;
-    delete fileTOC;
-
-    // remove sections not related to section titles
-    while(sectionTexts.size() > usedSections.size()) {
-        sectionTexts.erase(sectionTexts.end());
+    // every option that changes the output is part of the cache key, outputs with duplicates depend on the
+    // sections converted before them and indexed records must be tokenized, so both are never cached; the
+    // cache holds JSON lines only
+    std::unique_ptr<ResultCache> cache;
+    if((options["cache-memory"].as<size_t>() > 0 || options.count("cache-dir")) &&
+       conversion.dedup == DedupMode::Off && !options.count("index") && format == "json") {
+        cache = std::make_unique<ResultCache>(optionsFingerprint(conversion),
+                                              (uint64_t)options["cache-memory"].as<size_t>() << 20,
+                                              options.count("cache-dir") ? options["cache-dir"].as<std::string>() : "",
+                                              (uint64_t)options["cache-disk"].as<size_t>() << 20);
     }
 
-    nlohmann::json json;
+    // targeted extraction of the same documents reuses their opened and resolved state
+    std::unique_ptr<DocumentCache> documents;
+    if(options["document-cache"].as<size_t>() > 0) {
+        documents = std::make_unique<DocumentCache>((uint64_t)options["document-cache"].as<size_t>() << 20);
+    }
 
-    // create json object foreach section
-    for(std::string section: sectionTexts) {
-        nlohmann::json sectionJson{
-                {"title", title},
-                {"topic", fileName},
-                {"language", language},
-                {"text", section},
-                {"paragraph", usedSections.front()}
-        };
+    auto writeMetrics = [&]() {
+        if(options.count("metrics")) {
+            nlohmann::json metrics{
+                    {"limits", {{"cpus", limits.cpus}, {"memory", limits.memory}}},
+                    {"concurrency", controller.metrics()},
+                    {"topology", topologyMetrics(topology)},
+                    {"numa_pinning", numa != nullptr},
+                    {"locks", lockMetrics()}
+            };
+            if(cache != nullptr) {
+                metrics["result_cache"] = cache->metrics();
+            }
+            if(documents != nullptr) {
+                metrics["document_cache"] = documents->metrics();
+            }
+            if(conversion.duplicates != nullptr) {
+                metrics["duplicates"] = conversion.duplicates->metrics();
+            }
+            if(profiler != nullptr) {
+                metrics["profile"] = profiler->metrics();
+            }
+            if(options.count("perf-counters")) {
+                metrics["stage_counters"] = stageCounterMetrics();
+            }
+            metrics["utf8_repairs"] = repairMetrics();
+            nlohmann::json allocations = allocationMetrics();
+            if(!allocations.is_null()) {
+                metrics["allocations"] = allocations;
+            }
+            std::ofstream out(options["metrics"].as<std::string>());
+            out << metrics.dump(2) << std::endl;
+        }
+    };
 
-        json.push_back(sectionJson);
-        usedSections.pop();
-    }
+    if(options.count("queue")) {
+        // batches are published as files, a database cannot be renamed into place per batch
+        if(format != "json") {
+            std::cout << "Please use the json output format with a queue" << std::endl;
+            return 1;
+        }
 
-    // write json format of section list to a file
-    std::ofstream out("output.json", std::ofstream::in | std::ofstream::app);
+        QueueOptions queue;
+        queue.dir = options["queue"].as<std::string>();
+        queue.batchSize = options["batch-size"].as<size_t>();
+        queue.leaseTimeout = options["lease-timeout"].as<unsigned int>();
 
-    std::string output = json.dump();
-    out << output << std::endl;
+        // every worker may create the queue, the first one wins
+        if((!inputs.empty() && !initQueue(queue, inputs)) || !std::filesystem::exists(queue.dir + "/batches")) {
+            std::cout << "Please enter a writable queue directory and the paths to convert" << std::endl;
+            return 1;
+        }
 
-    out.close();
-}
+        // every queue worker writes its own index
+        if(options.count("index")) {
+            conversion.index = std::make_shared<IndexWriter>(options["index"].as<std::string>(),
+                                                             "index-" + workerName() + ".bin");
+        }
 
-/***
- * Convert all PDF files of the given directory and subdirectories
- * @param dir root directory
- * @param language language of PDF texts
- */
-void convertDirectory(const std::string& dir, const std::string& language) {
-    for(auto& entry: std::filesystem::directory_iterator(dir)) {
-        if(entry.is_directory()) {
-            convertDirectory(entry.path(), language);
+        runQueue(queue, [&](const std::vector<Input>& batch, OutputWriter& writer) {
+            convertInputs(batch, Shard(), conversion, writer, controller, numa, window, agingRate, cache.get(),
+                          documents.get());
+        });
+        if(conversion.index != nullptr && !conversion.index->finish()) {
+            std::cout << "Failed to write the index" << std::endl;
         }
-        else {
-            convertPDF(entry.path(), language);
+        writeMetrics();
+        return 0;
+    }
+
+    if(options.count("plan")) {
+        size_t count = options["plan"].as<size_t>();
+        if(count == 0) {
+            std::cout << "Please enter a positive number of shards" << std::endl;
+            return 1;
         }
+
+        printPlan(inputs, count);
+        return 0;
     }
-}
 
-/***
- * run PDF section to JSON conversion for all files in all given directories
- * @param argc list of arguments
- * @param argv language tag + list of directories with PDF files
- * @return status code
- */
-int main(int argc, char **argv) {
-    if(argc < 3) {
-        std::cout << "Please enter a language tag and a path to a PDF file" << std::endl;
+    if(options.count("sweep")) {
+        std::vector<float> thresholds;
+        if(!parseThresholds(options["sweep"].as<std::string>(), thresholds)) {
+            std::cout << "Please enter thresholds between 0 and 1 separated by commas" << std::endl;
+            return 1;
+        }
+
+        // the sweep runs its own pool outside of the controller
+        OutputWriter writer("", "skipped.json");
+        conversion.controller = nullptr;
+        runSweep(inputs, thresholds, conversion, controller.workers(), writer, "sweep.json");
+        return 0;
     }
-    else {
-        std::filesystem::remove("output.json");
-        std::string language = argv[1];
 
-        for(int i = 2; i < argc; i++) {
-            std::string path = argv[i];
+    Shard shard;
+    if(options.count("shard") && !parseShard(options["shard"].as<std::string>(), shard)) {
+        std::cout << "Please enter the shard as i/N with 1 <= i <= N" << std::endl;
+        return 1;
+    }
 
-            if(std::filesystem::is_directory(path)) {
-                convertDirectory(path, language);
-            }
-            else {
-                convertPDF(path, language);
-            }
+    // every shard writes its own files and a manifest for merging
+    std::string suffix;
+    if(options.count("shard")) {
+        suffix = "-" + std::to_string(shard.index) + "-of-" + std::to_string(shard.count);
+    }
+    if(format == "sqlite") {
+        conversion.sqlite = std::make_shared<SqliteSink>("output" + suffix + ".sqlite", options.count("fts") > 0);
+        if(!conversion.sqlite->valid()) {
+            return 1;
         }
     }
 
+    // the sqlite output replaces the JSON output and its manifest
+    bool json = conversion.sqlite == nullptr;
+    OutputWriter writer(json ? "output" + suffix + ".json" : "", "skipped" + suffix + ".json",
+                        suffix.empty() || !json ? "" : "manifest" + suffix + ".json");
+
+    if(options.count("index")) {
+        conversion.index = std::make_shared<IndexWriter>(options["index"].as<std::string>(),
+                                                         "index" + suffix + ".bin");
+    }
+
+    convertInputs(inputs, shard, conversion, writer, controller, numa, window, agingRate, cache.get(),
+                  documents.get());
+    if(conversion.index != nullptr && !conversion.index->finish()) {
+        std::cout << "Failed to write the index" << std::endl;
+    }
+    if(conversion.sqlite != nullptr && !conversion.sqlite->close()) {
+        std::cout << "Failed to write the sqlite output" << std::endl;
+    }
+    writeMetrics();
+
     return 0;
 }
@@ -0,0 +1,498 @@
+#include <algorithm>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <queue>
+#include <string>
+#include <tuple>
+#include <vector>
+#include <boost/program_options.hpp>
+#include <fcntl.h>
+#include <unistd.h>
+#include "include/nlohmann/json.hpp"
+#include "index.h"
+#include "output.h"
+#include "sqlite_sink.h"
+
+/***
+ * Manifest entry of a converted or skipped input
+ */
+struct ManifestEntry {
+    size_t seq = 0;
+    size_t member = 0;
+    std::string path;
+    // byte range of the output line including its line break
+    uint64_t offset = 0;
+    uint64_t length = 0;
+    size_t sections = 0;
+    // invalid UTF-8 sequences replaced in the document
+    size_t repairs = 0;
+    std::string topic;
+    // content hash of the PDF, empty in manifests of older runs
+    std::string hash;
+    bool skipped = false;
+    std::string reason;
+};
+
+/***
+ * Reader of a partial output file serving manifest ranges, runs of consecutive lines are read ahead into a window
+ * and out-of-order lines are read on their own
+ */
+class RangeReader {
+public:
+    /***
+     * Open an output file
+     * @param path output file of a shard or queue batch
+     * @param window maximum bytes of each read
+     */
+    RangeReader(const std::string& path, size_t window) : buffer(window) {
+        fd = open(path.c_str(), O_RDONLY);
+    }
+
+    ~RangeReader() {
+        if(fd >= 0) {
+            close(fd);
+        }
+    }
+
+    RangeReader(const RangeReader&) = delete;
+    RangeReader& operator=(const RangeReader&) = delete;
+
+    /***
+     * Check if the file was opened
+     * @return true if ranges can be read
+     */
+    bool valid() const {
+        return fd >= 0;
+    }
+
+    /***
+     * Read a byte range, from the window if it is buffered
+     * @param offset start of the range
+     * @param length bytes of the range
+     * @param out range content
+     * @return false if the file is shorter than the range
+     */
+    bool read(uint64_t offset, uint64_t length, std::string& out) {
+        bool consecutive = offset == next;
+        next = offset + length;
+
+        if(offset < start || offset + length > start + filled) {
+            // the scheduler completes small documents first, so the merge order jumps around in the file, a jump
+            // reads only its line and the read-ahead doubles with every miss of a consecutive run, like the kernel's
+            readAhead = consecutive ? std::clamp<uint64_t>(readAhead * 2, 64 << 10, buffer.size()) : 0;
+
+            // lines larger than the window are read directly
+            uint64_t size = std::max(length, readAhead);
+            if(size > buffer.size()) {
+                out.resize(length);
+                uint64_t done = readFully(offset, out.data(), length);
+                bytesRead += done;
+                return done == length;
+            }
+
+            start = offset;
+            filled = readFully(offset, buffer.data(), size);
+            bytesRead += filled;
+            if(length > filled) {
+                return false;
+            }
+        }
+
+        out.assign(buffer.data() + (offset - start), length);
+        return true;
+    }
+
+    uint64_t bytesRead = 0;
+
+private:
+    /***
+     * Read until the buffer is full or the file ends
+     * @param offset file offset
+     * @param data target buffer
+     * @param size bytes to read
+     * @return bytes read
+     */
+    uint64_t readFully(uint64_t offset, char* data, uint64_t size) {
+        uint64_t done = 0;
+        while(done < size) {
+            ssize_t n = pread(fd, data + done, size - done, (off_t)(offset + done));
+            if(n <= 0) {
+                break;
+            }
+            done += n;
+        }
+        return done;
+    }
+
+    int fd = -1;
+    std::vector<char> buffer;
+    uint64_t start = 0;
+    uint64_t filled = 0;
+    // end of the last range and bytes read beyond a missed range
+    uint64_t next = 0;
+    uint64_t readAhead = 0;
+};
+
+/***
+ * Partial output with its manifest entries sorted in merge order
+ */
+struct Source {
+    std::string manifest;
+    std::vector<ManifestEntry> entries;
+    size_t next = 0;
+    std::unique_ptr<RangeReader> reader;
+};
+
+/***
+ * Find the manifests of the given files and directories, directories are searched recursively
+ * @param paths manifest files or directories holding them
+ * @return manifest paths in a stable order
+ */
+static std::vector<std::string> findManifests(const std::vector<std::string>& paths) {
+    std::vector<std::string> manifests;
+    std::error_code error;
+
+    for(const std::string& path: paths) {
+        if(!std::filesystem::is_directory(path, error)) {
+            manifests.push_back(path);
+            continue;
+        }
+
+        // queue temporaries end in .tmp.<owner> and are never picked up
+        for(auto& entry: std::filesystem::recursive_directory_iterator(path, error)) {
+            std::string name = entry.path().filename().string();
+            if(entry.is_regular_file() && name.rfind("manifest", 0) == 0 && entry.path().extension() == ".json") {
+                manifests.push_back(entry.path().string());
+            }
+        }
+    }
+
+    std::sort(manifests.begin(), manifests.end());
+    manifests.erase(std::unique(manifests.begin(), manifests.end()), manifests.end());
+    return manifests;
+}
+
+/***
+ * Get the output file written next to a manifest, "manifest-3-of-8.json" belongs to "output-3-of-8.json"
+ * @param manifest manifest path
+ * @return output path
+ */
+static std::string outputOf(const std::string& manifest) {
+    std::filesystem::path path(manifest);
+    return (path.parent_path() / ("output" + path.filename().string().substr(8))).string();
+}
+
+/***
+ * Read all entries of a manifest
+ * @param path manifest path
+ * @param entries parsed entries
+ * @return false if the manifest cannot be read
+ */
+static bool readManifest(const std::string& path, std::vector<ManifestEntry>& entries) {
+    std::ifstream in(path);
+    if(!in) {
+        return false;
+    }
+
+    for(std::string line; std::getline(in, line);) {
+        nlohmann::json json = nlohmann::json::parse(line, nullptr, false);
+        // a worker killed while writing leaves a truncated last line
+        if(json.is_discarded() || !json.is_object()) {
+            continue;
+        }
+
+        ManifestEntry entry;
+        entry.seq = json.value("seq", (size_t)0);
+        entry.member = json.value("member", (size_t)0);
+        entry.path = json.value("path", "");
+        entry.skipped = json.value("status", "") != "ok";
+        entry.reason = json.value("reason", "");
+        if(!entry.skipped) {
+            entry.offset = json.value("offset", (uint64_t)0);
+            entry.length = json.value("length", (uint64_t)0);
+            entry.sections = json.value("sections", (size_t)0);
+            entry.repairs = json.value("utf8_repairs", (size_t)0);
+            entry.topic = json.value("topic", "");
+            entry.hash = json.value("hash", "");
+        }
+        entries.push_back(std::move(entry));
+    }
+    return true;
+}
+
+/***
+ * Insert the sections of a merged JSON line into the SQLite output
+ * @param sink SQLite output
+ * @param input merged input
+ * @param hash content hash of the PDF
+ * @param line JSON list of sections, null for a document without sections
+ */
+static void submitSqlite(SqliteSink& sink, const Input& input, const std::string& hash, const std::string& line) {
+    nlohmann::json sections = nlohmann::json::parse(line, nullptr, false);
+    if(!sections.is_array() && !sections.is_null()) {
+        return;
+    }
+
+    // documents without sections keep their row, as in a direct SQLite output
+    SqliteDocument document;
+    document.input = input;
+    document.hash = hash;
+    if(sections.is_null()) {
+        sink.submit(std::move(document));
+        return;
+    }
+    for(const nlohmann::json& section: sections) {
+        document.title = section.value("title", "");
+        document.language = section.value("language", "");
+
+        SqliteSection row;
+        row.paragraph = section.value("paragraph", "");
+        row.ordinal = section.value("ordinal", (size_t)0);
+        row.offset = section.value("offset", (size_t)0);
+        row.text = section.value("text", "");
+        row.simhash = section.value("simhash", "");
+        document.sections.push_back(std::move(row));
+    }
+    sink.submit(std::move(document));
+}
+
+/***
+ * Index the sections of a merged JSON line
+ * @param index index writer
+ * @param input merged input
+ * @param line JSON list of sections
+ */
+static void addIndex(IndexWriter& index, const Input& input, const std::string& line) {
+    nlohmann::json sections = nlohmann::json::parse(line, nullptr, false);
+    if(!sections.is_array()) {
+        return;
+    }
+
+    for(const nlohmann::json& section: sections) {
+        std::string text = section.value("text", "");
+        index.add(input.path, section.value("paragraph", ""), section.value("ordinal", (size_t)0), text);
+    }
+}
+
+/***
+ * merge the partial outputs of shards and queue batches into a single output ordered by input
+ * @param argc list of arguments
+ * @param argv options + manifests or directories holding them
+ * @return program exit code
+ */
+int main(int argc, char* argv[]) {
+    namespace po = boost::program_options;
+
+    po::options_description visible("Options");
+    visible.add_options()
+            ("help,h", "print this help")
+            ("order", po::value<std::string>()->default_value("seq"),
+             "merge order, seq for the input sequence number or path for the relative input path")
+            ("format", po::value<std::string>()->default_value("json"),
+             "output format, json lines or sqlite with documents and sections tables")
+            ("output,o", po::value<std::string>(), "merged output, output.json or output.sqlite by default")
+            ("skipped", po::value<std::string>()->default_value("skipped.json"), "merged skip list")
+            ("manifest", po::value<std::string>(), "write a manifest of the merged JSON output")
+            ("index", po::value<std::string>(), "build an inverted index of the merged records in this directory")
+            ("fts", "build an FTS5 full-text table over the sections of the sqlite output")
+            ("read-size", po::value<size_t>()->default_value(8), "maximum MiB read ahead from a partial output");
+
+    po::options_description hidden;
+    hidden.add_options()
+            ("paths", po::value<std::vector<std::string>>());
+
+    po::options_description all;
+    all.add(visible).add(hidden);
+
+    po::positional_options_description positional;
+    positional.add("paths", -1);
+
+    po::variables_map options;
+    try {
+        po::store(po::command_line_parser(argc, argv).options(all).positional(positional).run(), options);
+    }
+    catch(const po::error& error) {
+        std::cout << error.what() << std::endl;
+        return 1;
+    }
+
+    if(options.count("help") || !options.count("paths")) {
+        std::cout << "Usage: PDF2TextMerge [options] manifests or directories..." << std::endl << visible
+                  << std::endl;
+        return 0;
+    }
+
+    std::string order = options["order"].as<std::string>();
+    std::string format = options["format"].as<std::string>();
+    if(order != "seq" && order != "path") {
+        std::cout << "Please enter seq or path as merge order" << std::endl;
+        return 1;
+    }
+    if(format != "json" && format != "sqlite") {
+        std::cout << "Please enter json or sqlite as output format" << std::endl;
+        return 1;
+    }
+    std::string output = options.count("output") ? options["output"].as<std::string>() : "output." + format;
+
+    // a retried entry sorts next to its first attempt, converted before skipped attempts
+    auto before = [&](const ManifestEntry& a, const ManifestEntry& b) {
+        if(order == "seq") {
+            return std::tie(a.seq, a.member, a.path, a.skipped) < std::tie(b.seq, b.member, b.path, b.skipped);
+        }
+        return std::tie(a.path, a.member, a.seq, a.skipped) < std::tie(b.path, b.member, b.seq, b.skipped);
+    };
+
+    size_t window = std::max<size_t>(1, options["read-size"].as<size_t>()) << 20;
+    std::vector<Source> sources;
+    std::error_code error;
+
+    for(const std::string& manifest: findManifests(options["paths"].as<std::vector<std::string>>())) {
+        Source source;
+        source.manifest = manifest;
+        if(!readManifest(manifest, source.entries)) {
+            std::cout << "Skipping unreadable manifest " << manifest << std::endl;
+            continue;
+        }
+
+        std::string file = outputOf(manifest);
+        if(format == "json" && std::filesystem::equivalent(file, output, error)) {
+            std::cout << "The merged output would replace its input " << file << std::endl;
+            return 1;
+        }
+
+        // lines are written in completion order, which differs from the input order
+        std::stable_sort(source.entries.begin(), source.entries.end(), before);
+        source.reader = std::make_unique<RangeReader>(file, window);
+        if(!source.reader->valid()) {
+            std::cout << "Skipping manifest without output " << manifest << std::endl;
+            continue;
+        }
+        sources.push_back(std::move(source));
+    }
+
+    if(sources.empty()) {
+        std::cout << "No manifests found" << std::endl;
+        return 1;
+    }
+
+    std::shared_ptr<SqliteSink> sqlite;
+    if(format == "sqlite") {
+        sqlite = std::make_shared<SqliteSink>(output, options.count("fts") > 0);
+        if(!sqlite->valid()) {
+            std::cout << "Failed to create the sqlite output" << std::endl;
+            return 1;
+        }
+    }
+    std::unique_ptr<IndexWriter> index;
+    if(options.count("index")) {
+        index = std::make_unique<IndexWriter>(options["index"].as<std::string>(), "index.bin");
+    }
+    OutputWriter writer(format == "json" ? output : "", options["skipped"].as<std::string>(),
+                        format == "json" && options.count("manifest") ? options["manifest"].as<std::string>() : "");
+
+    // min-heap over the next entry of every source
+    auto later = [&](size_t a, size_t b) {
+        return before(sources[b].entries[sources[b].next], sources[a].entries[sources[a].next]);
+    };
+    std::priority_queue<size_t, std::vector<size_t>, decltype(later)> heap(later);
+    for(size_t i = 0; i < sources.size(); i++) {
+        if(!sources[i].entries.empty()) {
+            heap.push(i);
+        }
+    }
+
+    size_t written = 0;
+    size_t skipped = 0;
+    size_t duplicates = 0;
+    size_t corrupt = 0;
+    bool emitted = false;
+    ManifestEntry last;
+    std::string line;
+
+    while(!heap.empty()) {
+        size_t i = heap.top();
+        heap.pop();
+        Source& source = sources[i];
+        const ManifestEntry& entry = source.entries[source.next];
+
+        // only the first attempt of an input is kept, retried batches repeat their entries
+        bool duplicate = emitted && entry.seq == last.seq && entry.member == last.member && entry.path == last.path;
+
+        if(duplicate) {
+            duplicates++;
+        }
+        else if(entry.skipped) {
+            Input input;
+            input.path = entry.path;
+            input.relative = entry.path;
+            input.seq = entry.seq;
+            input.member = entry.member;
+            writer.skip(input, entry.reason);
+            skipped++;
+            last = entry;
+            emitted = true;
+        }
+        else if(!source.reader->read(entry.offset, entry.length, line) || line.empty() || line.back() != '\n') {
+            // a later attempt of the same input may still hold an intact line
+            std::cout << "Skipping corrupt record " << entry.path << " in " << source.manifest << std::endl;
+            corrupt++;
+        }
+        else {
+            line.pop_back();
+
+            Input input;
+            input.path = entry.path;
+            input.relative = entry.path;
+            input.topic = entry.topic;
+            input.seq = entry.seq;
+            input.member = entry.member;
+
+            if(sqlite != nullptr) {
+                submitSqlite(*sqlite, input, entry.hash, line);
+            }
+            else {
+                writer.write(input, line, entry.sections, entry.repairs, entry.hash);
+            }
+            if(index != nullptr) {
+                addIndex(*index, input, line);
+            }
+            written++;
+            last = entry;
+            emitted = true;
+        }
+
+        if(++source.next < source.entries.size()) {
+            heap.push(i);
+        }
+    }
+
+    bool failed = false;
+    if(index != nullptr && !index->finish()) {
+        std::cout << "Failed to write the index" << std::endl;
+        failed = true;
+    }
+    if(sqlite != nullptr && !sqlite->close()) {
+        std::cout << "Failed to write the sqlite output" << std::endl;
+        failed = true;
+    }
+
+    uint64_t bytesRead = 0;
+    for(const Source& source: sources) {
+        bytesRead += source.reader->bytesRead;
+    }
+
+    nlohmann::json report{
+            {"sources", sources.size()},
+            {"written", written},
+            {"skipped", skipped},
+            {"duplicates", duplicates},
+            {"corrupt", corrupt},
+            {"bytes_read", bytesRead}
+    };
+    std::cout << report.dump() << std::endl;
+
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,525 @@
+#include <algorithm>
+#include <atomic>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include <boost/program_options.hpp>
+#include "include/nlohmann/json.hpp"
+#include "index.h"
+#include "sqlite_sink.h"
+
+/***
+ * Section record of an output line, filled field by field by the SAX parser
+ */
+struct LegacySection {
+    std::string title;
+    std::string topic;
+    std::string language;
+    std::string paragraph;
+    std::string text;
+    std::string simhash;
+    size_t ordinal = 0;
+    size_t offset = 0;
+    bool hasOrdinal = false;
+    bool hasOffset = false;
+
+    // earlier section this one duplicates
+    bool duplicate = false;
+    std::string duplicatePath;
+    std::string duplicateParagraph;
+    size_t duplicateOrdinal = 0;
+};
+
+/***
+ * SAX handler for an output line, hands every section to a visitor as soon as its object closes, so a line is
+ * never held as JSON DOM
+ */
+class SectionHandler : public nlohmann::json_sax<nlohmann::json> {
+public:
+    /***
+     * Create a handler
+     * @param visitor callback for every section of the line
+     */
+    explicit SectionHandler(std::function<void(LegacySection&)> visitor) : visitor(std::move(visitor)) {
+    }
+
+    bool null() override {
+        return consumed();
+    }
+
+    bool boolean(bool) override {
+        return consumed();
+    }
+
+    bool number_integer(number_integer_t value) override {
+        return number_unsigned(value < 0 ? 0 : (number_unsigned_t)value);
+    }
+
+    bool number_unsigned(number_unsigned_t value) override {
+        if(number != nullptr) {
+            *number = (size_t)value;
+            if(number == &section.ordinal) {
+                section.hasOrdinal = true;
+            }
+            else if(number == &section.offset) {
+                section.hasOffset = true;
+            }
+        }
+        return consumed();
+    }
+
+    bool number_float(number_float_t, const string_t&) override {
+        return consumed();
+    }
+
+    bool string(string_t& value) override {
+        if(target != nullptr) {
+            *target = std::move(value);
+        }
+        return consumed();
+    }
+
+    bool binary(binary_t&) override {
+        return consumed();
+    }
+
+    bool start_object(std::size_t) override {
+        depth++;
+        // the only nested object of a section
+        if(depth == 3 && currentKey == "duplicate_of") {
+            section.duplicate = true;
+        }
+        return consumed();
+    }
+
+    bool key(string_t& name) override {
+        consumed();
+        currentKey = name;
+
+        if(depth == 2) {
+            if(name == "text") {
+                target = &section.text;
+            }
+            else if(name == "paragraph") {
+                target = &section.paragraph;
+            }
+            else if(name == "title") {
+                target = &section.title;
+            }
+            else if(name == "topic") {
+                target = &section.topic;
+            }
+            else if(name == "language") {
+                target = &section.language;
+            }
+            else if(name == "simhash") {
+                target = &section.simhash;
+            }
+            else if(name == "ordinal") {
+                number = &section.ordinal;
+            }
+            else if(name == "offset") {
+                number = &section.offset;
+            }
+        }
+        else if(depth == 3 && section.duplicate) {
+            if(name == "path") {
+                target = &section.duplicatePath;
+            }
+            else if(name == "paragraph") {
+                target = &section.duplicateParagraph;
+            }
+            else if(name == "ordinal") {
+                number = &section.duplicateOrdinal;
+            }
+        }
+        return true;
+    }
+
+    bool end_object() override {
+        if(depth == 2) {
+            visitor(section);
+            section = LegacySection();
+        }
+        depth--;
+        return consumed();
+    }
+
+    bool start_array(std::size_t) override {
+        depth++;
+        return consumed();
+    }
+
+    bool end_array() override {
+        depth--;
+        return consumed();
+    }
+
+    bool parse_error(std::size_t position, const std::string&, const nlohmann::detail::exception& exception) override {
+        error = "byte " + std::to_string(position) + ": " + exception.what();
+        return false;
+    }
+
+    /***
+     * Drop the state of a line that failed to parse
+     */
+    void reset() {
+        section = LegacySection();
+        depth = 0;
+        consumed();
+    }
+
+    // message of the last parse error
+    std::string error;
+
+private:
+    /***
+     * Forget the field of the current key after its value was read
+     * @return true to continue parsing
+     */
+    bool consumed() {
+        number = nullptr;
+        target = nullptr;
+        return true;
+    }
+
+    std::function<void(LegacySection&)> visitor;
+    LegacySection section;
+    int depth = 0;
+    std::string currentKey;
+    // field receiving the next value, nullptr to ignore it
+    std::string* target = nullptr;
+    size_t* number = nullptr;
+};
+
+/***
+ * Input of an output line, located through the manifest written next to the output
+ */
+struct LineOrigin {
+    size_t seq = 0;
+    size_t member = 0;
+    std::string path;
+};
+
+/***
+ * Read the manifest of an output file, "output-3-of-8.json" belongs to "manifest-3-of-8.json"
+ * @param file output file
+ * @return inputs by line offset, empty if there is no manifest
+ */
+static std::unordered_map<uint64_t, LineOrigin> readOrigins(const std::filesystem::path& file) {
+    std::unordered_map<uint64_t, LineOrigin> origins;
+    std::string name = file.filename().string();
+    if(name.rfind("output", 0) != 0) {
+        return origins;
+    }
+
+    std::ifstream in(file.parent_path() / ("manifest" + name.substr(6)));
+    for(std::string line; std::getline(in, line);) {
+        nlohmann::json entry = nlohmann::json::parse(line, nullptr, false);
+        if(entry.is_object() && entry.value("status", "") == "ok") {
+            origins[entry.value("offset", (uint64_t)0)] = {entry.value("seq", (size_t)0),
+                                                           entry.value("member", (size_t)0), entry.value("path", "")};
+        }
+    }
+    return origins;
+}
+
+/***
+ * Serialize a section as a self-contained JSONL record
+ * @param origin input of the section
+ * @param section parsed section
+ * @return JSON line without line break
+ */
+static std::string recordLine(const LineOrigin& origin, LegacySection& section) {
+    nlohmann::json record{
+            {"seq", origin.seq},
+            {"member", origin.member},
+            {"path", origin.path},
+            {"title", std::move(section.title)},
+            {"topic", std::move(section.topic)},
+            {"language", std::move(section.language)},
+            {"paragraph", std::move(section.paragraph)},
+            {"text", std::move(section.text)}
+    };
+    if(section.hasOrdinal) {
+        record["ordinal"] = section.ordinal;
+    }
+    if(section.hasOffset) {
+        record["offset"] = section.offset;
+    }
+    if(!section.simhash.empty()) {
+        record["simhash"] = std::move(section.simhash);
+    }
+    if(section.duplicate) {
+        record["duplicate_of"] = {
+                {"path", std::move(section.duplicatePath)},
+                {"paragraph", std::move(section.duplicateParagraph)},
+                {"ordinal", section.duplicateOrdinal}
+        };
+    }
+    return record.dump();
+}
+
+/***
+ * Counters of a migration
+ */
+struct MigrationStats {
+    std::atomic<size_t> files{0};
+    std::atomic<size_t> lines{0};
+    std::atomic<size_t> sections{0};
+    std::atomic<size_t> errors{0};
+    std::atomic<uint64_t> bytes{0};
+};
+
+/***
+ * Targets of a migration, all optional
+ */
+struct MigrationTargets {
+    // directory of the JSONL files, empty to skip them
+    std::string jsonl;
+    std::shared_ptr<SqliteSink> sqlite;
+    std::shared_ptr<IndexWriter> index;
+};
+
+/***
+ * Get a name of an output file that is unique among all migrated files, every run, shard and queue batch writes an
+ * "output.json" or "output-N-of-M.json" of the same name
+ * @param file output file
+ * @return path relative to the working directory, or the absolute path without its root outside of it
+ */
+static std::filesystem::path sourceName(const std::filesystem::path& file) {
+    std::error_code error;
+    std::filesystem::path absolute = std::filesystem::absolute(file, error).lexically_normal();
+    std::filesystem::path relative = absolute.lexically_relative(std::filesystem::current_path(error));
+    if(!relative.empty() && *relative.begin() != "..") {
+        return relative;
+    }
+    return absolute.relative_path();
+}
+
+/***
+ * Stream an output file line by line into the migration targets
+ * @param file output file in the one-array-per-line format
+ * @param targets migration targets
+ * @param stats migration counters
+ */
+static void migrateFile(const std::filesystem::path& file, const MigrationTargets& targets, MigrationStats& stats) {
+    std::unordered_map<uint64_t, LineOrigin> origins = readOrigins(file);
+
+    std::vector<char> readBuffer(1 << 20);
+    std::ifstream in;
+    in.rdbuf()->pubsetbuf(readBuffer.data(), (std::streamsize)readBuffer.size());
+    in.open(file, std::ifstream::binary);
+    if(!in) {
+        std::cout << "Skipping unreadable file " << file.string() << std::endl;
+        stats.errors++;
+        return;
+    }
+
+    // the JSONL files mirror the directories of the sources, so same-named outputs do not overwrite each other
+    std::filesystem::path name = sourceName(file);
+    std::vector<char> writeBuffer(1 << 20);
+    std::ofstream out;
+    if(!targets.jsonl.empty()) {
+        std::filesystem::path target = std::filesystem::path(targets.jsonl) / name;
+        target.replace_extension(".jsonl");
+
+        std::error_code error;
+        std::filesystem::create_directories(target.parent_path(), error);
+        out.rdbuf()->pubsetbuf(writeBuffer.data(), (std::streamsize)writeBuffer.size());
+        out.open(target, std::ofstream::trunc);
+        if(!out) {
+            std::cout << "Failed to create " << target.string() << std::endl;
+            stats.errors++;
+            return;
+        }
+    }
+
+    LineOrigin origin;
+    SqliteDocument document;
+
+    // sections go to every target while the parser is still inside the line
+    SectionHandler handler([&](LegacySection& section) {
+        if(targets.index != nullptr) {
+            targets.index->add(origin.path, section.paragraph, section.ordinal, section.text);
+        }
+        if(targets.sqlite != nullptr) {
+            document.title = section.title;
+            document.language = section.language;
+            document.input.topic = section.topic;
+            document.sections.push_back({section.paragraph, section.ordinal, section.offset,
+                                         out.is_open() ? section.text : std::move(section.text), section.simhash});
+        }
+        if(out.is_open()) {
+            out << recordLine(origin, section) << '\n';
+        }
+        stats.sections++;
+    });
+
+    uint64_t offset = 0;
+    size_t number = 0;
+    for(std::string line; std::getline(in, line); number++) {
+        // without a manifest a line is named by its file and line number
+        auto found = origins.find(offset);
+        if(found != origins.end()) {
+            origin = found->second;
+        }
+        else {
+            origin = {number, 0, name.generic_string() + ":" + std::to_string(number + 1)};
+        }
+        offset += line.size() + 1;
+
+        document = SqliteDocument();
+        document.input.path = origin.path;
+        document.input.relative = origin.path;
+        document.input.seq = origin.seq;
+        document.input.member = origin.member;
+
+        // sections before the error of a truncated line were already written and are kept
+        if(!nlohmann::json::sax_parse(line, &handler)) {
+            std::cout << "Invalid line " << number + 1 << " of " << file.string() << ", " << handler.error << std::endl;
+            handler.reset();
+            stats.errors++;
+        }
+
+        if(targets.sqlite != nullptr) {
+            targets.sqlite->submit(std::move(document));
+        }
+        stats.lines++;
+    }
+
+    stats.bytes += offset;
+    stats.files++;
+}
+
+/***
+ * migrate output files of the one-array-per-line format into JSONL, SQLite and the section index without building a
+ * JSON DOM per line
+ * @param argc list of arguments
+ * @param argv options + output files or directories holding them
+ * @return program exit code
+ */
+int main(int argc, char* argv[]) {
+    namespace po = boost::program_options;
+
+    po::options_description visible("Options");
+    visible.add_options()
+            ("help,h", "print this help")
+            ("jsonl", po::value<std::string>(), "write records per line, mirroring the source paths in this directory")
+            ("sqlite", po::value<std::string>(), "write a sqlite output with documents and sections tables")
+            ("fts", "build an FTS5 full-text table over the sections of the sqlite output")
+            ("index", po::value<std::string>(), "build an inverted index of the records in this directory")
+            ("jobs,j", po::value<size_t>()->default_value(std::max(1u, std::thread::hardware_concurrency())),
+             "files migrated in parallel");
+
+    po::options_description hidden;
+    hidden.add_options()
+            ("paths", po::value<std::vector<std::string>>());
+
+    po::options_description all;
+    all.add(visible).add(hidden);
+
+    po::positional_options_description positional;
+    positional.add("paths", -1);
+
+    po::variables_map options;
+    try {
+        po::store(po::command_line_parser(argc, argv).options(all).positional(positional).run(), options);
+    }
+    catch(const po::error& error) {
+        std::cout << error.what() << std::endl;
+        return 1;
+    }
+
+    if(options.count("help") || !options.count("paths") ||
+       !(options.count("jsonl") || options.count("sqlite") || options.count("index"))) {
+        std::cout << "Usage: PDF2TextMigrate [options] files or directories..." << std::endl << visible << std::endl;
+        return 0;
+    }
+
+    // directories hold outputs of whole runs, shards or queue batches
+    std::vector<std::filesystem::path> files;
+    std::error_code error;
+    for(const std::string& path: options["paths"].as<std::vector<std::string>>()) {
+        if(!std::filesystem::is_directory(path, error)) {
+            files.emplace_back(path);
+            continue;
+        }
+        for(auto& entry: std::filesystem::recursive_directory_iterator(path, error)) {
+            std::string name = entry.path().filename().string();
+            if(entry.is_regular_file() && name.rfind("output", 0) == 0 && entry.path().extension() == ".json") {
+                files.push_back(entry.path());
+            }
+        }
+    }
+    // a file given twice would be migrated twice into the same target
+    for(std::filesystem::path& file: files) {
+        file = std::filesystem::absolute(file, error).lexically_normal();
+    }
+    std::sort(files.begin(), files.end());
+    files.erase(std::unique(files.begin(), files.end()), files.end());
+
+    MigrationTargets targets;
+    if(options.count("jsonl")) {
+        targets.jsonl = options["jsonl"].as<std::string>();
+        std::filesystem::create_directories(targets.jsonl, error);
+    }
+    if(options.count("sqlite")) {
+        targets.sqlite = std::make_shared<SqliteSink>(options["sqlite"].as<std::string>(), options.count("fts") > 0);
+        if(!targets.sqlite->valid()) {
+            std::cout << "Failed to create the sqlite output" << std::endl;
+            return 1;
+        }
+    }
+    if(options.count("index")) {
+        targets.index = std::make_shared<IndexWriter>(options["index"].as<std::string>(), "index.bin");
+    }
+
+    // largest files first, so a huge file does not start last
+    std::stable_sort(files.begin(), files.end(), [](const std::filesystem::path& a, const std::filesystem::path& b) {
+        std::error_code error;
+        return std::filesystem::file_size(a, error) > std::filesystem::file_size(b, error);
+    });
+
+    MigrationStats stats;
+    std::atomic<size_t> next{0};
+    std::vector<std::thread> pool;
+    size_t jobs = std::clamp<size_t>(options["jobs"].as<size_t>(), 1, std::max<size_t>(1, files.size()));
+    for(size_t i = 0; i < jobs; i++) {
+        pool.emplace_back([&]() {
+            for(size_t f = next++; f < files.size(); f = next++) {
+                migrateFile(files[f], targets, stats);
+            }
+        });
+    }
+    for(std::thread& thread: pool) {
+        thread.join();
+    }
+
+    bool failed = false;
+    if(targets.index != nullptr && !targets.index->finish()) {
+        std::cout << "Failed to write the index" << std::endl;
+        failed = true;
+    }
+    if(targets.sqlite != nullptr && !targets.sqlite->close()) {
+        std::cout << "Failed to write the sqlite output" << std::endl;
+        failed = true;
+    }
+
+    nlohmann::json report{
+            {"files", stats.files.load()},
+            {"lines", stats.lines.load()},
+            {"sections", stats.sections.load()},
+            {"errors", stats.errors.load()},
+            {"bytes", stats.bytes.load()}
+    };
+    std::cout << report.dump() << std::endl;
+
+    return failed ? 1 : 0;
+}
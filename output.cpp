@@ -0,0 +1,87 @@
+#include "output.h"
+
+#include "include/nlohmann/json.hpp"
+
+/***
+ * Serialize a manifest or skip list entry, file names are bytes and not necessarily valid UTF-8
+ * @param entry entry
+ * @return JSON line with invalid sequences replaced by U+FFFD
+ */
+static std::string dumpEntry(const nlohmann::json& entry) {
+    return entry.dump(-1, ' ', false, nlohmann::json::error_handler_t::replace);
+}
+
+OutputWriter::OutputWriter(const std::string& output, const std::string& skipped, const std::string& manifest)
+        : skipped(skipped, std::ofstream::trunc) {
+    if(!output.empty()) {
+        out.open(output, std::ofstream::trunc);
+    }
+    if(!manifest.empty()) {
+        this->manifest.open(manifest, std::ofstream::trunc);
+    }
+}
+
+void OutputWriter::write(const Input& input, const std::string& line, size_t sections, size_t repairs,
+                         const std::string& hash) {
+    write(input, std::vector<std::string>{line}, sections, repairs, hash);
+}
+
+void OutputWriter::write(const Input& input, const std::vector<std::string>& chunks, size_t sections,
+                         size_t repairs, const std::string& hash) {
+    size_t length = 1;
+    for(const std::string& chunk: chunks) {
+        length += chunk.size();
+    }
+
+    std::lock_guard<CountingMutex> lock(mutex);
+
+    // chunks larger than the stream buffer are gathered with the buffered bytes into a single writev
+    for(const std::string& chunk: chunks) {
+        out.write(chunk.data(), (std::streamsize)chunk.size());
+    }
+    out << std::endl;
+
+    // manifest entries locate each line for merging shard outputs by sequence number
+    if(manifest.is_open()) {
+        nlohmann::json entry{
+                {"seq", input.seq},
+                {"member", input.member},
+                {"path", input.relative},
+                {"offset", offset},
+                {"length", length},
+                {"sections", sections},
+                {"status", "ok"},
+                {"topic", input.topic}
+        };
+        // the merge tool builds SQLite documents from the manifest, empty documents have no section to take them from
+        if(!hash.empty()) {
+            entry["hash"] = hash;
+        }
+        if(repairs > 0) {
+            entry["utf8_repairs"] = repairs;
+        }
+        manifest << dumpEntry(entry) << std::endl;
+    }
+
+    offset += length;
+}
+
+void OutputWriter::skip(const Input& input, const std::string& reason) {
+    std::lock_guard<CountingMutex> lock(mutex);
+    nlohmann::json entry{
+            {"file", input.path},
+            {"reason", reason}
+    };
+    skipped << dumpEntry(entry) << std::endl;
+
+    if(manifest.is_open()) {
+        nlohmann::json manifestEntry{
+                {"seq", input.seq},
+                {"member", input.member},
+                {"path", input.relative},
+                {"status", "skipped"},
+                {"reason", reason}
+        };
+        manifest << dumpEntry(manifestEntry) << std::endl;
+    }
+}
@@ -0,0 +1,71 @@
+#ifndef PDF2TEXT_OUTPUT_H
+#define PDF2TEXT_OUTPUT_H
+
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "input.h"
+#include "lock_stats.h"
+
+/***
+ * Writer for the JSON output, the skip list and the optional merge manifest, safe to share between workers
+ */
+class OutputWriter {
+public:
+    /***
+     * Create all output files, existing files are replaced
+     * @param output path of the JSON output, empty to disable it
+     * @param skipped path of the skip list
+     * @param manifest path of the manifest, empty to disable it
+     */
+    OutputWriter(const std::string& output, const std::string& skipped, const std::string& manifest = "");
+
+    /***
+     * Append the JSON line of a converted input
+     * @param input converted input
+     * @param line serialized section list
+     * @param sections number of sections
+     * @param repairs invalid UTF-8 sequences replaced in the document, listed in the manifest if any
+     * @param hash content hash of the PDF for the manifest, empty if unknown
+     */
+    void write(const Input& input, const std::string& line, size_t sections, size_t repairs = 0,
+               const std::string& hash = "");
+
+    /***
+     * Append the JSON line of a converted input given in chunks, without joining them
+     * @param input converted input
+     * @param chunks serialized section list in order
+     * @param sections number of sections
+     * @param repairs invalid UTF-8 sequences replaced in the document, listed in the manifest if any
+     * @param hash content hash of the PDF for the manifest, empty if unknown
+     */
+    void write(const Input& input, const std::vector<std::string>& chunks, size_t sections, size_t repairs = 0,
+               const std::string& hash = "");
+
+    /***
+     * Check if a manifest is written
+     * @return true if written lines are listed in a manifest
+     */
+    bool hasManifest() const {
+        return manifest.is_open();
+    }
+
+    /***
+     * Append an input that was not converted to the skip list
+     * @param input skipped input
+     * @param reason reason for skipping the input
+     */
+    void skip(const Input& input, const std::string& reason);
+
+private:
+    CountingMutex mutex{"output_writer"};
+    std::ofstream out;
+    std::ofstream skipped;
+    std::ofstream manifest;
+
+    // byte offset of the next output line
+    uint64_t offset = 0;
+};
+
+#endif //PDF2TEXT_OUTPUT_H
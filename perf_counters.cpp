@@ -0,0 +1,221 @@
+#include "perf_counters.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+/***
+ * Hardware event counted per stage
+ */
+struct CounterSpec {
+    const char* name;
+    uint32_t type;
+    uint64_t config;
+};
+
+static const CounterSpec counterSpecs[] = {
+        {"cycles",        PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+        {"instructions",  PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+        {"l1d_misses",    PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                                              (PERF_COUNT_HW_CACHE_RESULT_MISS << 16)},
+        {"llc_misses",    PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES},
+        {"branch_misses", PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES}
+};
+static const size_t counterCount = sizeof(counterSpecs) / sizeof(counterSpecs[0]);
+
+static std::atomic<bool> enabled{false};
+static std::atomic<uint64_t> totals[stageCount][counterCount];
+static std::atomic<uint64_t> stageBytes[stageCount];
+static std::atomic<size_t> threadsWithoutCounters{0};
+
+// events the kernel or the CPU does not support, they are reported instead of failing all counters
+static std::mutex statusMutex;
+static std::string unavailable;
+static std::vector<std::string> unsupported;
+
+/***
+ * Counter group of a thread, closed when the thread exits
+ */
+struct ThreadCounters {
+    bool opened = false;
+    int leader = -1;
+    std::vector<int> fds;
+    // position of every spec in the group read, -1 if it could not be opened
+    int slot[counterCount];
+
+    uint64_t last[counterCount] = {};
+    uint64_t lastEnabled = 0;
+    uint64_t lastRunning = 0;
+
+    ~ThreadCounters() {
+        for(int fd: fds) {
+            close(fd);
+        }
+    }
+};
+
+static thread_local ThreadCounters threadCounters;
+
+/***
+ * Open a counter of the calling thread, user space only so restricted perf_event_paranoid levels still allow it
+ * @param spec counted event
+ * @param group group leader, -1 to open a leader
+ * @return file descriptor, -1 on failure
+ */
+static int openCounter(const CounterSpec& spec, int group) {
+    perf_event_attr attributes{};
+    attributes.size = sizeof(attributes);
+    attributes.type = spec.type;
+    attributes.config = spec.config;
+    attributes.exclude_kernel = 1;
+    attributes.exclude_hv = 1;
+    attributes.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    attributes.disabled = group == -1;
+
+    return (int)syscall(SYS_perf_event_open, &attributes, 0, -1, group, 0);
+}
+
+/***
+ * Open the counter group of the calling thread once
+ * @param counters counters of the calling thread
+ * @return true if the group counts
+ */
+static bool openGroup(ThreadCounters& counters) {
+    if(counters.opened) {
+        return counters.leader >= 0;
+    }
+    counters.opened = true;
+
+    counters.leader = openCounter(counterSpecs[0], -1);
+    if(counters.leader < 0) {
+        return false;
+    }
+    counters.fds.push_back(counters.leader);
+    counters.slot[0] = 0;
+
+    for(size_t c = 1; c < counterCount; c++) {
+        int fd = openCounter(counterSpecs[c], counters.leader);
+        if(fd < 0) {
+            counters.slot[c] = -1;
+            std::lock_guard<std::mutex> lock(statusMutex);
+            if(std::find(unsupported.begin(), unsupported.end(), counterSpecs[c].name) == unsupported.end()) {
+                unsupported.emplace_back(counterSpecs[c].name);
+            }
+            continue;
+        }
+        counters.slot[c] = (int)counters.fds.size();
+        counters.fds.push_back(fd);
+    }
+
+    ioctl(counters.leader, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+    ioctl(counters.leader, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+    return true;
+}
+
+bool startStageCounters() {
+    // the calling thread finds out if the counters work at all
+    if(!openGroup(threadCounters)) {
+        std::lock_guard<std::mutex> lock(statusMutex);
+        unavailable = std::string("perf_event_open: ") + std::strerror(errno);
+        return false;
+    }
+    enabled = true;
+    return true;
+}
+
+void stageBoundary(Stage stage) {
+    if(!enabled.load(std::memory_order_relaxed)) {
+        return;
+    }
+
+    ThreadCounters& counters = threadCounters;
+    if(!counters.opened && !openGroup(counters)) {
+        // usually the open file limit, the other threads still count
+        threadsWithoutCounters++;
+        return;
+    }
+    if(counters.leader < 0) {
+        return;
+    }
+
+    // a single read returns the whole group: count, time enabled, time running, values
+    uint64_t data[3 + counterCount];
+    ssize_t size = read(counters.leader, data, sizeof(data));
+    if(size < (ssize_t)(3 * sizeof(uint64_t))) {
+        return;
+    }
+
+    uint64_t enabledTime = data[1] - counters.lastEnabled;
+    uint64_t runningTime = data[2] - counters.lastRunning;
+    counters.lastEnabled = data[1];
+    counters.lastRunning = data[2];
+
+    for(size_t c = 0; c < counterCount; c++) {
+        if(counters.slot[c] < 0 || (uint64_t)counters.slot[c] >= data[0]) {
+            continue;
+        }
+
+        uint64_t value = data[3 + counters.slot[c]];
+        uint64_t delta = value - counters.last[c];
+        counters.last[c] = value;
+
+        // the group was multiplexed with other events, extrapolate to the whole interval
+        if(runningTime > 0 && runningTime < enabledTime) {
+            delta = (uint64_t)((double)delta * (double)enabledTime / (double)runningTime);
+        }
+        totals[(size_t)stage][c].fetch_add(delta, std::memory_order_relaxed);
+    }
+}
+
+void addStageBytes(Stage stage, uint64_t bytes) {
+    if(enabled.load(std::memory_order_relaxed)) {
+        stageBytes[(size_t)stage].fetch_add(bytes, std::memory_order_relaxed);
+    }
+}
+
+nlohmann::json stageCounterMetrics() {
+    std::lock_guard<std::mutex> lock(statusMutex);
+    if(!unavailable.empty()) {
+        return {{"available", false}, {"reason", unavailable}};
+    }
+
+    nlohmann::json stages = nlohmann::json::object();
+    for(size_t s = 0; s < stageCount; s++) {
+        uint64_t cycles = totals[s][0].load();
+        if(cycles == 0) {
+            continue;
+        }
+
+        nlohmann::json stage;
+        for(size_t c = 0; c < counterCount; c++) {
+            stage[counterSpecs[c].name] = totals[s][c].load();
+        }
+        stage["ipc"] = (double)totals[s][1].load() / (double)cycles;
+
+        // stages without a byte count only report absolute numbers
+        uint64_t bytes = stageBytes[s].load();
+        stage["bytes"] = bytes;
+        if(bytes > 0) {
+            stage["cycles_per_byte"] = (double)cycles / (double)bytes;
+            for(size_t c = 2; c < counterCount; c++) {
+                stage[std::string(counterSpecs[c].name) + "_per_byte"] = (double)totals[s][c].load() / (double)bytes;
+            }
+        }
+        stages[stageName((Stage)s)] = stage;
+    }
+
+    return {
+            {"available", true},
+            {"unsupported", unsupported},
+            {"threads_without_counters", threadsWithoutCounters.load()},
+            {"stages", stages}
+    };
+}
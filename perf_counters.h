@@ -0,0 +1,34 @@
+#ifndef PDF2TEXT_PERF_COUNTERS_H
+#define PDF2TEXT_PERF_COUNTERS_H
+
+#include <cstdint>
+#include "include/nlohmann/json.hpp"
+#include "profiler.h"
+
+/***
+ * Start counting cycles, instructions, cache misses and branch misses per pipeline stage, every thread opens its
+ * counter group when it first crosses a stage boundary
+ * @return false if the counters are unavailable, the reason is part of the metrics
+ */
+bool startStageCounters();
+
+/***
+ * Attribute the counts of the calling thread since its last boundary to a stage, called by StageScope
+ * @param stage stage the thread worked on
+ */
+void stageBoundary(Stage stage);
+
+/***
+ * Count bytes processed by a stage, the denominator of the per-byte metrics
+ * @param stage pipeline stage
+ * @param bytes processed bytes
+ */
+void addStageBytes(Stage stage, uint64_t bytes);
+
+/***
+ * Get the counts of all stages for the metrics report
+ * @return counts, IPC and misses per byte by stage as JSON object
+ */
+nlohmann::json stageCounterMetrics();
+
+#endif //PDF2TEXT_PERF_COUNTERS_H
@@ -0,0 +1,141 @@
+#ifndef PDF2TEXT_PIPELINE_H
+#define PDF2TEXT_PIPELINE_H
+
+#include <functional>
+#include <queue>
+#include <stack>
+#include <string>
+#include <vector>
+#include <poppler/cpp/poppler-document.h>
+#include "converter.h"
+
+/***
+ * Extract the text of a PDF page into sections, instantiated per title search so it inlines into the page loop
+ * @param sections list for all section titles
+ * @param sectionTexts list of all sections
+ * @param content PDF page content
+ * @param usedSections list of already processed sections
+ * @param threshold maximum Levenshtein distance of a title match relative to the title length
+ * @param find title search returning a TitleMatch for page content and title
+ */
+template<typename Matcher>
+void extractSections(std::stack<std::string>& sections, std::vector<std::string>& sectionTexts, std::string content,
+                     std::queue<std::string>& usedSections, float threshold, const Matcher& find) {
+    // run until the full page has been processed
+    while(!sections.empty()) {
+        // get first section from stack
+        const std::string& separator = sections.top();
+
+        // section title not found, append the full remaining content to the last found section
+        TitleMatch match = find(content, separator);
+        if(!titleMatches(match, separator, threshold)) {
+            sectionTexts.back().append(content);
+            return;
+        }
+
+        // append content after the section title and keep the content before it, without copying segments
+        sectionTexts.back().append(content, match.pos, std::string::npos);
+        content.resize(match.pos);
+
+        // store title of finished section, then create new section and move to next title
+        usedSections.push(separator);
+        sections.pop();
+        sectionTexts.emplace_back("");
+    }
+}
+
+/***
+ * Text layer of PDF pages read with poppler
+ */
+struct PopplerBackend {
+    /***
+     * Read the raw text of a page
+     * @param document opened document
+     * @param index page index
+     * @return page text, empty if the page cannot be loaded
+     */
+    static std::string pageText(const poppler::document& document, int index);
+};
+
+/***
+ * Page normalizer collapsing every whitespace run into a single space
+ */
+struct WhitespaceNormalizer {
+    /***
+     * Normalize a page text
+     * @param text raw page text
+     * @return normalized text
+     */
+    static std::string normalize(const std::string& text) {
+        std::string result;
+        result.reserve(text.size());
+
+        // same result as replacing \s+ with a space, without running a regex over every page
+        for(char c: text) {
+            if(c == ' ' || c == '\t' || c == '\n' || c == '\v' || c == '\f' || c == '\r') {
+                if(result.empty() || result.back() != ' ') {
+                    result.push_back(' ');
+                }
+            }
+            else {
+                result.push_back(c);
+            }
+        }
+        return result;
+    }
+};
+
+/***
+ * Page normalizer keeping paragraph breaks as '\n'
+ */
+struct ParagraphNormalizer {
+    /***
+     * Normalize a page text
+     * @param text raw page text
+     * @return normalized text
+     */
+    static std::string normalize(const std::string& text) {
+        return normalizeParagraphs(text);
+    }
+};
+
+/***
+ * Section title search by Levenshtein distance
+ */
+struct LevenshteinMatcher {
+    TitleMatch operator()(const std::string& content, const std::string& separator) const {
+        return findTitle(content, separator);
+    }
+};
+
+/***
+ * Page conversion specialized at compile time for a text backend, page normalizer and title matcher, so no stage
+ * is called through a type-erased function inside the page loop
+ */
+template<typename Backend, typename Normalizer, typename Matcher>
+struct Pipeline {
+    /***
+     * Get the normalized text of a page, extracting it only once per document
+     * @param document opened document
+     * @param index page index
+     * @param keep true to keep the text for later requests
+     * @return page text
+     */
+    static std::string pageText(CachedDocument& document, int index, bool keep);
+
+    /***
+     * Convert pages until the document is done or the caller asks to preempt it
+     * @param conversion conversion state
+     * @param options conversion options
+     * @param preempt checked after every page, true pauses the conversion
+     * @return true if all pages were converted
+     */
+    static bool convertPages(Conversion& conversion, const ConversionOptions& options,
+                             const std::function<bool()>& preempt);
+};
+
+// instantiated in converter.cpp, pageText() and convertPages() select one of them per document
+extern template struct Pipeline<PopplerBackend, WhitespaceNormalizer, LevenshteinMatcher>;
+extern template struct Pipeline<PopplerBackend, ParagraphNormalizer, LevenshteinMatcher>;
+
+#endif //PDF2TEXT_PIPELINE_H
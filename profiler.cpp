@@ -0,0 +1,314 @@
+#include "profiler.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <cxxabi.h>
+#include <dlfcn.h>
+#include <pthread.h>
+#include <sys/time.h>
+#include <ucontext.h>
+#include "perf_counters.h"
+
+// deepest unwound stack, deeper frames are cut off at the root
+static const size_t maxFrames = 64;
+// ring slots, a power of two
+static const size_t ringSize = 1 << 14;
+
+/***
+ * Sample written by the signal handler
+ */
+struct Sample {
+    // ring position this slot is free for, or published at plus one
+    std::atomic<uint64_t> sequence{0};
+    Stage stage = Stage::Other;
+    uint32_t depth = 0;
+    uintptr_t frames[maxFrames];
+};
+
+// samples are preallocated, the signal handler must not allocate
+static Sample ring[ringSize];
+static std::atomic<uint64_t> ringHead{0};
+static uint64_t ringTail = 0;
+static std::atomic<uint64_t> dropped{0};
+
+/***
+ * Stack bounds of a thread, the unwinder never reads outside of them
+ */
+struct StackBounds {
+    uintptr_t low = 0;
+    uintptr_t high = 0;
+};
+
+// the profiler is linked into the executable, so its thread locals are static TLS and safe in a signal handler
+static thread_local Stage currentStage = Stage::Other;
+static thread_local StackBounds stackBounds;
+
+const char* stageName(Stage stage) {
+    switch(stage) {
+        case Stage::Read:
+            return "read";
+        case Stage::Open:
+            return "open";
+        case Stage::Text:
+            return "text";
+        case Stage::Match:
+            return "match";
+        case Stage::Serialize:
+            return "serialize";
+        case Stage::Index:
+            return "index";
+        case Stage::Write:
+            return "write";
+        case Stage::Sqlite:
+            return "sqlite";
+        default:
+            return "other";
+    }
+}
+
+Stage currentThreadStage() {
+    return currentStage;
+}
+
+StageScope::StageScope(Stage stage) : previous(currentStage) {
+    // a thread's stack is only walked once it entered a stage
+    if(stackBounds.high == 0) {
+        pthread_attr_t attributes;
+        if(pthread_getattr_np(pthread_self(), &attributes) == 0) {
+            void* address;
+            size_t size;
+            if(pthread_attr_getstack(&attributes, &address, &size) == 0) {
+                stackBounds.low = (uintptr_t)address;
+                stackBounds.high = (uintptr_t)address + size;
+            }
+            pthread_attr_destroy(&attributes);
+        }
+    }
+    stageBoundary(previous);
+    currentStage = stage;
+}
+
+StageScope::~StageScope() {
+    stageBoundary(currentStage);
+    currentStage = previous;
+}
+
+/***
+ * Record the interrupted stack by following frame pointers, async-signal-safe
+ * @param signal SIGPROF
+ * @param info signal information
+ * @param context interrupted register state
+ */
+static void onProfile(int, siginfo_t*, void* context) {
+    int savedErrno = errno;
+
+    // claim a free slot, a full ring drops the sample instead of blocking
+    uint64_t position = ringHead.load(std::memory_order_relaxed);
+    Sample* sample;
+    while(true) {
+        sample = &ring[position & (ringSize - 1)];
+        uint64_t sequence = sample->sequence.load(std::memory_order_acquire);
+        if(sequence == position) {
+            if(ringHead.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+                break;
+            }
+        }
+        else if(sequence < position) {
+            dropped.fetch_add(1, std::memory_order_relaxed);
+            errno = savedErrno;
+            return;
+        }
+        else {
+            position = ringHead.load(std::memory_order_relaxed);
+        }
+    }
+
+    sample->stage = currentStage;
+    sample->depth = 0;
+
+    auto* registers = &((ucontext_t*)context)->uc_mcontext;
+#if defined(__x86_64__)
+    uintptr_t pc = registers->gregs[REG_RIP];
+    uintptr_t fp = registers->gregs[REG_RBP];
+    uintptr_t sp = registers->gregs[REG_RSP];
+#elif defined(__aarch64__)
+    uintptr_t pc = registers->pc;
+    uintptr_t fp = registers->regs[29];
+    uintptr_t sp = registers->sp;
+#else
+    uintptr_t pc = 0;
+    uintptr_t fp = 0;
+    uintptr_t sp = 0;
+#endif
+    if(pc != 0) {
+        sample->frames[sample->depth++] = pc;
+    }
+
+    // every frame stores the caller's frame pointer and the return address, frames grow towards higher addresses
+    StackBounds bounds = stackBounds;
+    while(sample->depth < maxFrames && fp >= sp && fp >= bounds.low && fp + 2 * sizeof(uintptr_t) <= bounds.high &&
+          fp % sizeof(uintptr_t) == 0) {
+        auto* frame = (const uintptr_t*)fp;
+        uintptr_t next = frame[0];
+        uintptr_t ret = frame[1];
+        if(ret == 0) {
+            break;
+        }
+
+        sample->frames[sample->depth++] = ret;
+        if(next <= fp) {
+            break;
+        }
+        fp = next;
+    }
+
+    sample->sequence.store(position + 1, std::memory_order_release);
+    errno = savedErrno;
+}
+
+/***
+ * Get a folded stack frame name of a code address
+ * @param address code address
+ * @return demangled function name, or module and offset if the symbol is not exported
+ */
+static std::string frameName(uintptr_t address) {
+    Dl_info info;
+    if(dladdr((void*)address, &info) == 0) {
+        char name[32];
+        std::snprintf(name, sizeof(name), "0x%zx", (size_t)address);
+        return name;
+    }
+
+    std::string name;
+    if(info.dli_sname != nullptr) {
+        int status;
+        char* demangled = abi::__cxa_demangle(info.dli_sname, nullptr, nullptr, &status);
+        name = status == 0 ? demangled : info.dli_sname;
+        std::free(demangled);
+    }
+    else {
+        const char* module = info.dli_fname != nullptr ? std::strrchr(info.dli_fname, '/') : nullptr;
+        name = module != nullptr ? module + 1 : "?";
+
+        // static functions of the executable keep their offset for addr2line, libraries are merged into one frame
+        if(name.find(".so") == std::string::npos) {
+            char offset[32];
+            std::snprintf(offset, sizeof(offset), "+0x%zx", (size_t)(address - (uintptr_t)info.dli_fbase));
+            name += offset;
+        }
+    }
+
+    // ';' separates frames in the folded format
+    for(char& c: name) {
+        if(c == ';') {
+            c = ':';
+        }
+    }
+    return name;
+}
+
+Profiler::Profiler(const std::string& path, unsigned int frequency) : path(path) {
+    for(size_t i = 0; i < ringSize; i++) {
+        ring[i].sequence.store(i, std::memory_order_relaxed);
+    }
+    ringHead = 0;
+    ringTail = 0;
+    dropped = 0;
+
+    // entering a stage registers the stack of the calling thread for the unwinder
+    StageScope scope(Stage::Other);
+
+    struct sigaction action{};
+    action.sa_sigaction = onProfile;
+    action.sa_flags = SA_SIGINFO | SA_RESTART;
+    sigemptyset(&action.sa_mask);
+    sigaction(SIGPROF, &action, nullptr);
+
+    collector = std::thread(&Profiler::collect, this);
+
+    // ITIMER_PROF counts CPU time of all threads, busy threads receive proportionally more samples
+    unsigned int interval = 1000000 / std::max(1u, std::min(frequency, 1000u));
+    struct itimerval timer{};
+    timer.it_interval.tv_sec = interval / 1000000;
+    timer.it_interval.tv_usec = interval % 1000000;
+    timer.it_value = timer.it_interval;
+    setitimer(ITIMER_PROF, &timer, nullptr);
+}
+
+Profiler::~Profiler() {
+    struct itimerval timer{};
+    setitimer(ITIMER_PROF, &timer, nullptr);
+
+    // a signal still pending must not terminate the process
+    signal(SIGPROF, SIG_IGN);
+
+    running = false;
+    collector.join();
+    drain();
+
+    // root first, the stage is the root frame
+    std::map<std::string, uint64_t> folded;
+    std::map<uintptr_t, std::string> names;
+    for(auto& stack: stacks) {
+        std::string line = stageName((Stage)stack.first[0]);
+        for(size_t i = stack.first.size() - 1; i >= 1; i--) {
+            // return addresses point behind the call, the leaf is the interrupted instruction
+            uintptr_t address = i > 1 ? stack.first[i] - 1 : stack.first[i];
+            auto name = names.find(address);
+            if(name == names.end()) {
+                name = names.emplace(address, frameName(address)).first;
+            }
+            line += ";" + name->second;
+        }
+        folded[line] += stack.second;
+    }
+
+    std::ofstream out(path, std::ofstream::trunc);
+    for(auto& line: folded) {
+        out << line.first << " " << line.second << "\n";
+    }
+    if(!out) {
+        std::cout << "Failed to write the profile " << path << std::endl;
+    }
+}
+
+void Profiler::collect() {
+    while(running) {
+        drain();
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    }
+}
+
+void Profiler::drain() {
+    while(true) {
+        Sample& sample = ring[ringTail & (ringSize - 1)];
+        if(sample.sequence.load(std::memory_order_acquire) != ringTail + 1) {
+            return;
+        }
+
+        std::vector<uintptr_t> key;
+        key.reserve(sample.depth + 1);
+        key.push_back((uintptr_t)sample.stage);
+        key.insert(key.end(), sample.frames, sample.frames + sample.depth);
+        stacks[key]++;
+        samples++;
+
+        // hand the slot back to the handlers for the next lap
+        sample.sequence.store(ringTail + ringSize, std::memory_order_release);
+        ringTail++;
+    }
+}
+
+nlohmann::json Profiler::metrics() {
+    return {
+            {"samples", samples.load()},
+            {"dropped", dropped.load()}
+    };
+}
@@ -0,0 +1,111 @@
+#ifndef PDF2TEXT_PROFILER_H
+#define PDF2TEXT_PROFILER_H
+
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <thread>
+#include <vector>
+#include "include/nlohmann/json.hpp"
+
+/***
+ * Pipeline stage a thread is working on, recorded with every profiler sample
+ */
+enum class Stage : uint8_t {
+    Other,
+    Read,
+    Open,
+    Text,
+    Match,
+    Serialize,
+    Index,
+    Write,
+    // keep last, counters are kept per stage up to it
+    Sqlite
+};
+
+// number of stages
+const size_t stageCount = (size_t)Stage::Sqlite + 1;
+
+/***
+ * Get the name of a stage used as root frame of the folded stacks
+ * @param stage pipeline stage
+ * @return stage name
+ */
+const char* stageName(Stage stage);
+
+/***
+ * Get the stage the calling thread is working on
+ * @return pipeline stage, Other outside of any stage scope
+ */
+Stage currentThreadStage();
+
+/***
+ * Tags the calling thread with a stage until the scope ends, nested scopes restore the outer stage, both boundaries
+ * read the hardware counters if they are enabled
+ */
+class StageScope {
+public:
+    /***
+     * Enter a stage
+     * @param stage pipeline stage
+     */
+    explicit StageScope(Stage stage);
+    ~StageScope();
+
+    StageScope(const StageScope&) = delete;
+    StageScope& operator=(const StageScope&) = delete;
+
+private:
+    Stage previous;
+};
+
+/***
+ * Sampling profiler driven by SIGPROF, samples are unwound in the signal handler into a preallocated ring and
+ * aggregated by a collector thread, the folded stacks are written when the profiler is destroyed
+ */
+class Profiler {
+public:
+    /***
+     * Start sampling the process CPU time, only one profiler may run at a time
+     * @param path output file of the folded stacks
+     * @param frequency samples per second of CPU time
+     */
+    Profiler(const std::string& path, unsigned int frequency);
+
+    /***
+     * Stop sampling and write the folded stacks
+     */
+    ~Profiler();
+
+    Profiler(const Profiler&) = delete;
+    Profiler& operator=(const Profiler&) = delete;
+
+    /***
+     * Get sample counters for the metrics report
+     * @return metrics as JSON object
+     */
+    nlohmann::json metrics();
+
+private:
+    /***
+     * Move samples from the ring into the stack counts until the profiler stops
+     */
+    void collect();
+
+    /***
+     * Move all published samples from the ring into the stack counts
+     */
+    void drain();
+
+    std::string path;
+    std::atomic<bool> running{true};
+    std::thread collector;
+
+    // sample counts by stage and return addresses, leaf first
+    std::map<std::vector<uintptr_t>, uint64_t> stacks;
+    std::atomic<uint64_t> samples{0};
+};
+
+#endif //PDF2TEXT_PROFILER_H
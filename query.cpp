@@ -0,0 +1,125 @@
+#include <algorithm>
+#include <cmath>
+#include <filesystem>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <boost/program_options.hpp>
+#include "include/nlohmann/json.hpp"
+#include "index.h"
+
+/***
+ * search indexes written by PDF2Text --index for sections containing all query terms
+ * @param argc list of arguments
+ * @param argv options + index directory or file + query terms
+ * @return program exit code
+ */
+int main(int argc, char* argv[]) {
+    namespace po = boost::program_options;
+
+    po::options_description visible("Options");
+    visible.add_options()
+            ("help,h", "print this help")
+            ("limit,n", po::value<size_t>()->default_value(10), "number of printed sections");
+
+    po::options_description hidden;
+    hidden.add_options()
+            ("index", po::value<std::string>())
+            ("terms", po::value<std::vector<std::string>>());
+
+    po::options_description all;
+    all.add(visible).add(hidden);
+
+    po::positional_options_description positional;
+    positional.add("index", 1).add("terms", -1);
+
+    po::variables_map options;
+    try {
+        po::store(po::command_line_parser(argc, argv).options(all).positional(positional).run(), options);
+    }
+    catch(const po::error& error) {
+        std::cout << error.what() << std::endl;
+        return 1;
+    }
+
+    if(options.count("help") || !options.count("index") || !options.count("terms")) {
+        std::cout << "Usage: PDF2TextQuery [options] index terms..." << std::endl << visible << std::endl;
+        return 0;
+    }
+
+    // a directory holds one index per run, shard or queue worker
+    std::vector<std::string> files;
+    std::string path = options["index"].as<std::string>();
+    if(std::filesystem::is_directory(path)) {
+        for(auto& entry: std::filesystem::directory_iterator(path)) {
+            if(entry.path().extension() == ".bin") {
+                files.push_back(entry.path().string());
+            }
+        }
+        std::sort(files.begin(), files.end());
+    }
+    else {
+        files.push_back(path);
+    }
+
+    std::vector<std::string> terms;
+    for(const std::string& argument: options["terms"].as<std::vector<std::string>>()) {
+        tokenize(argument, [&](std::string_view term) { terms.emplace_back(term); });
+    }
+
+    // sections containing all terms, ranked by TF-IDF
+    std::vector<std::pair<double, std::string>> results;
+    for(const std::string& file: files) {
+        IndexReader reader(file);
+        if(!reader.valid()) {
+            std::cout << "Skipping invalid index " << file << std::endl;
+            continue;
+        }
+
+        std::vector<std::pair<uint64_t, double>> matches;
+        std::vector<std::pair<uint64_t, uint32_t>> postings;
+        for(size_t t = 0; t < terms.size(); t++) {
+            if(!reader.lookup(terms[t], postings)) {
+                matches.clear();
+                break;
+            }
+
+            double idf = std::log(1.0 + (double)reader.documentCount() / (double)postings.size());
+            if(t == 0) {
+                for(auto& posting: postings) {
+                    matches.emplace_back(posting.first, posting.second * idf);
+                }
+                continue;
+            }
+
+            // intersect the sorted lists
+            std::vector<std::pair<uint64_t, double>> both;
+            auto posting = postings.begin();
+            for(auto& match: matches) {
+                while(posting != postings.end() && posting->first < match.first) {
+                    posting++;
+                }
+                if(posting != postings.end() && posting->first == match.first) {
+                    both.emplace_back(match.first, match.second + posting->second * idf);
+                }
+            }
+            matches = std::move(both);
+        }
+
+        for(auto& match: matches) {
+            results.emplace_back(match.second, std::string(reader.document(match.first)));
+        }
+    }
+
+    size_t limit = std::min(options["limit"].as<size_t>(), results.size());
+    std::partial_sort(results.begin(), results.begin() + limit, results.end(),
+                      [](const auto& a, const auto& b) { return a.first > b.first; });
+
+    for(size_t i = 0; i < limit; i++) {
+        nlohmann::json result = nlohmann::json::parse(results[i].second);
+        result["score"] = results[i].first;
+        std::cout << result.dump() << std::endl;
+    }
+
+    return 0;
+}
@@ -0,0 +1,296 @@
+#include "queue.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <fcntl.h>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <sys/stat.h>
+#include <thread>
+#include <unistd.h>
+#include "include/nlohmann/json.hpp"
+
+std::string workerName() {
+    char host[256] = "localhost";
+    gethostname(host, sizeof(host) - 1);
+    return std::string(host) + "." + std::to_string(getpid());
+}
+
+/***
+ * Get the current time of the shared file system, immune to clock skew between hosts
+ * @param dir queue directory
+ * @param owner worker name
+ * @return current file system time in seconds
+ */
+static time_t fileSystemNow(const std::string& dir, const std::string& owner) {
+    int fd = open((dir + "/clock/" + owner).c_str(), O_CREAT | O_WRONLY, 0644);
+    if(fd < 0) {
+        return time(nullptr);
+    }
+
+    struct stat status{};
+    futimens(fd, nullptr);
+    fstat(fd, &status);
+    close(fd);
+    return status.st_mtime;
+}
+
+bool initQueue(const QueueOptions& options, const std::vector<Input>& inputs) {
+    std::error_code error;
+    for(const char* sub: {"leases", "done", "out", "clock"}) {
+        std::filesystem::create_directories(options.dir + "/" + sub, error);
+        if(error) {
+            return false;
+        }
+    }
+
+    std::string batches = options.dir + "/batches";
+    if(std::filesystem::exists(batches)) {
+        return true;
+    }
+
+    // write all batches into a private directory and publish them with one atomic rename
+    std::string staging = batches + ".tmp." + workerName();
+    std::filesystem::create_directories(staging, error);
+    if(error) {
+        return false;
+    }
+
+    size_t batchSize = std::max<size_t>(options.batchSize, 1);
+    for(size_t first = 0; first < inputs.size(); first += batchSize) {
+        char name[32];
+        std::snprintf(name, sizeof(name), "/%06zu.json", first / batchSize);
+        std::ofstream batch(staging + name);
+
+        for(size_t i = first; i < std::min(inputs.size(), first + batchSize); i++) {
+            nlohmann::json entry{
+                    {"seq", inputs[i].seq},
+                    {"path", inputs[i].path},
+                    {"relative", inputs[i].relative},
+                    {"topic", inputs[i].topic}
+            };
+            // an invalid UTF-8 path is replaced, the file is then skipped as unreadable instead of stopping the queue
+            batch << entry.dump(-1, ' ', false, nlohmann::json::error_handler_t::replace) << std::endl;
+        }
+    }
+
+    // another worker initialized the queue first
+    if(rename(staging.c_str(), batches.c_str()) != 0) {
+        std::filesystem::remove_all(staging, error);
+    }
+    return std::filesystem::exists(batches);
+}
+
+/***
+ * Read the owner token of a lease
+ * @param lease lease file
+ * @return token, empty if the lease does not exist
+ */
+static std::string leaseToken(const std::string& lease) {
+    std::ifstream in(lease);
+    std::string token;
+    std::getline(in, token);
+    return token;
+}
+
+/***
+ * Try to take the lease of a batch, reclaiming it if its owner stopped heartbeating
+ * @param options queue settings
+ * @param batch batch name
+ * @param owner worker name
+ * @param token unique token of this claim, written into the lease
+ * @return true if this worker owns the batch
+ */
+static bool claimBatch(const QueueOptions& options, const std::string& batch, const std::string& owner,
+                       const std::string& token) {
+    std::string lease = options.dir + "/leases/" + batch;
+
+    for(int attempt = 0; attempt < 2; attempt++) {
+        int fd = open(lease.c_str(), O_CREAT | O_EXCL | O_WRONLY, 0644);
+        if(fd >= 0) {
+            dprintf(fd, "%s\n", token.c_str());
+            close(fd);
+
+            // the previous owner may have finished right before its lease was removed
+            if(std::filesystem::exists(options.dir + "/done/" + batch)) {
+                unlink(lease.c_str());
+                return false;
+            }
+            return true;
+        }
+        if(errno != EEXIST) {
+            return false;
+        }
+
+        struct stat status{};
+        if(stat(lease.c_str(), &status) != 0) {
+            // lease was released in the meantime
+            continue;
+        }
+        if(fileSystemNow(options.dir, owner) - status.st_mtime <= (time_t)options.leaseTimeout) {
+            return false;
+        }
+
+        // another worker may have reclaimed or its owner renewed the lease since the stat, the moved file tells
+        std::string expired = lease + ".expired." + owner;
+        if(rename(lease.c_str(), expired.c_str()) != 0) {
+            return false;
+        }
+        struct stat moved{};
+        if(stat(expired.c_str(), &moved) != 0 ||
+           fileSystemNow(options.dir, owner) - moved.st_mtime <= (time_t)options.leaseTimeout) {
+            // hand a live lease back, if it was claimed again in the meantime its owner finds its token gone
+            link(expired.c_str(), lease.c_str());
+            unlink(expired.c_str());
+            return false;
+        }
+        unlink(expired.c_str());
+    }
+    return false;
+}
+
+/***
+ * Read the inputs of a batch file
+ * @param file batch file
+ * @return inputs of the batch
+ */
+static std::vector<Input> readBatch(const std::string& file) {
+    std::vector<Input> inputs;
+    std::ifstream in(file);
+    std::string line;
+
+    while(std::getline(in, line)) {
+        nlohmann::json entry = nlohmann::json::parse(line);
+
+        Input input;
+        input.seq = entry["seq"];
+        input.path = entry["path"];
+        input.relative = entry["relative"];
+        input.topic = entry["topic"];
+        inputs.push_back(input);
+    }
+    return inputs;
+}
+
+/***
+ * Convert a claimed batch while renewing its lease, then publish the output atomically
+ * @param options queue settings
+ * @param batch batch name
+ * @param owner worker name
+ * @param token token of the claim
+ * @param handler callback converting the inputs
+ * @return false if the lease was lost and the output discarded
+ */
+static bool processBatch(const QueueOptions& options, const std::string& batch, const std::string& owner,
+                         const std::string& token, const BatchHandler& handler) {
+    std::string lease = options.dir + "/leases/" + batch;
+    std::string id = batch.substr(0, batch.find('.'));
+
+    std::mutex mutex;
+    std::condition_variable stopped;
+    bool finished = false;
+    bool lost = false;
+
+    // heartbeat renews the lease several times per timeout, as long as the lease still holds this claim's token
+    std::thread heartbeat([&]() {
+        auto interval = std::chrono::milliseconds(std::max(1000u * options.leaseTimeout / 3, 100u));
+        std::unique_lock<std::mutex> lock(mutex);
+
+        while(!stopped.wait_for(lock, interval, [&]() { return finished; })) {
+            if(leaseToken(lease) != token || utimensat(AT_FDCWD, lease.c_str(), nullptr, 0) != 0) {
+                std::cerr << "lost lease of batch " << id << std::endl;
+                lost = true;
+                break;
+            }
+        }
+    });
+
+    std::vector<Input> inputs = readBatch(options.dir + "/batches/" + batch);
+    std::string out = options.dir + "/out/";
+    std::string temporary = ".tmp." + owner;
+
+    {
+        OutputWriter writer(out + "output-" + id + ".json" + temporary, out + "skipped-" + id + ".json" + temporary,
+                            out + "manifest-" + id + ".json" + temporary);
+        handler(inputs, writer);
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        finished = true;
+    }
+    stopped.notify_one();
+    heartbeat.join();
+
+    // the new owner of a lost lease publishes the batch
+    if(lost || leaseToken(lease) != token) {
+        for(const char* kind: {"output-", "skipped-", "manifest-"}) {
+            unlink((out + kind + id + ".json" + temporary).c_str());
+        }
+        return false;
+    }
+
+    for(const char* kind: {"output-", "skipped-", "manifest-"}) {
+        std::string file = out + kind + id + ".json";
+        rename((file + temporary).c_str(), file.c_str());
+    }
+
+    int fd = open((options.dir + "/done/" + batch).c_str(), O_CREAT | O_WRONLY, 0644);
+    if(fd >= 0) {
+        close(fd);
+    }
+    unlink(lease.c_str());
+    return true;
+}
+
+size_t runQueue(const QueueOptions& options, const BatchHandler& handler) {
+    std::string owner = workerName();
+    std::vector<std::string> batches;
+
+    for(auto& entry: std::filesystem::directory_iterator(options.dir + "/batches")) {
+        batches.push_back(entry.path().filename().string());
+    }
+    std::sort(batches.begin(), batches.end());
+
+    size_t converted = 0;
+    size_t claims = 0;
+
+    while(true) {
+        bool pending = false;
+        bool claimed = false;
+
+        for(const std::string& batch: batches) {
+            if(std::filesystem::exists(options.dir + "/done/" + batch)) {
+                continue;
+            }
+
+            // a worker may claim the same batch again after losing it, every claim has its own token
+            std::string token = owner + "." + std::to_string(claims++);
+            if(claimBatch(options, batch, owner, token)) {
+                if(processBatch(options, batch, owner, token, handler)) {
+                    converted++;
+                }
+                claimed = true;
+            }
+            else {
+                // leased by another worker, retry once its lease may have expired
+                pending = true;
+            }
+        }
+
+        if(!pending) {
+            break;
+        }
+        if(!claimed) {
+            std::this_thread::sleep_for(std::chrono::seconds(std::clamp(options.leaseTimeout / 4, 1u, 5u)));
+        }
+    }
+
+    unlink((options.dir + "/clock/" + owner).c_str());
+    return converted;
+}
@@ -0,0 +1,51 @@
+#ifndef PDF2TEXT_QUEUE_H
+#define PDF2TEXT_QUEUE_H
+
+#include <functional>
+#include <string>
+#include <vector>
+#include "input.h"
+#include "output.h"
+
+/***
+ * Settings of the shared file system work queue
+ */
+struct QueueOptions {
+    // queue directory shared by all workers
+    std::string dir;
+    // number of inputs per batch
+    size_t batchSize = 16;
+    // seconds without heartbeat until a lease may be claimed by another worker
+    unsigned int leaseTimeout = 60;
+};
+
+/***
+ * Callback converting all inputs of a claimed batch
+ * @param inputs inputs of the batch
+ * @param writer output of the batch
+ */
+using BatchHandler = std::function<void(const std::vector<Input>& inputs, OutputWriter& writer)>;
+
+/***
+ * Get a worker name unique across all hosts sharing the queue
+ * @return host name and process id
+ */
+std::string workerName();
+
+/***
+ * Split the inputs into batch files, unless another worker already did
+ * @param options queue settings
+ * @param inputs all command line inputs
+ * @return false if the queue directory could not be written
+ */
+bool initQueue(const QueueOptions& options, const std::vector<Input>& inputs);
+
+/***
+ * Claim and convert batches until every batch is done
+ * @param options queue settings
+ * @param handler callback for every claimed batch
+ * @return number of batches converted by this worker
+ */
+size_t runQueue(const QueueOptions& options, const BatchHandler& handler);
+
+#endif //PDF2TEXT_QUEUE_H
@@ -0,0 +1,271 @@
+#include "result_cache.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <thread>
+#include <unistd.h>
+#include "hash.h"
+
+ResultCache::ResultCache(const std::string& options, uint64_t memoryLimit, const std::string& dir,
+                         uint64_t diskLimit)
+        : optionsHash(xxh64(options)), memoryLimit(memoryLimit), root(dir), diskLimit(diskLimit) {
+    if(root.empty()) {
+        return;
+    }
+
+    // runs with other options keep their entries, unused ones age out of the shared limit
+    char name[17];
+    std::snprintf(name, sizeof(name), "%016llx", (unsigned long long)optionsHash);
+    this->dir = root + "/" + name;
+
+    std::error_code error;
+    std::filesystem::create_directories(this->dir, error);
+
+    if(!std::filesystem::exists(this->dir + "/OPTIONS", error)) {
+        std::ofstream out(this->dir + "/OPTIONS", std::ofstream::trunc);
+        out << options << std::endl;
+    }
+
+    for(auto& entry: std::filesystem::recursive_directory_iterator(root, error)) {
+        if(entry.path().extension() == ".json") {
+            diskUsed += entry.file_size(error);
+        }
+    }
+}
+
+std::string ResultCache::key(const std::vector<char>& data) const {
+    char key[48];
+    std::snprintf(key, sizeof(key), "%016llx%08zx%016llx", (unsigned long long)xxh64({data.data(), data.size()}),
+                  data.size() & 0xffffffff, (unsigned long long)optionsHash);
+    return key;
+}
+
+/***
+ * Replace the topic of all sections of a serialized output
+ * @param result cached output
+ * @param topic new topic
+ * @return false if the output is not valid JSON
+ */
+static bool retopic(CachedResult& result, const std::string& topic) {
+    if(result.topic == topic) {
+        return true;
+    }
+
+    nlohmann::json json = nlohmann::json::parse(result.line, nullptr, false);
+    if(json.is_discarded()) {
+        return false;
+    }
+    if(json.is_array()) {
+        for(nlohmann::json& section: json) {
+            section["topic"] = topic;
+        }
+    }
+
+    result.line = json.dump(-1, ' ', false, nlohmann::json::error_handler_t::replace);
+    result.topic = topic;
+    return true;
+}
+
+/***
+ * Read an entry of the on-disk tier
+ * @param file entry file
+ * @param result cached output
+ * @return false if the file is missing, truncated or corrupt
+ */
+static bool readEntry(const std::string& file, CachedResult& result) {
+    std::ifstream in(file);
+    std::string header;
+
+    // both lines end with a newline, a missing one means the output line was cut off
+    if(!std::getline(in, header) || !std::getline(in, result.line) || in.eof()) {
+        return false;
+    }
+
+    nlohmann::json meta = nlohmann::json::parse(header, nullptr, false);
+    if(!meta.is_object() || !meta.contains("topic") || !meta["topic"].is_string() || !meta.contains("sections") ||
+       !meta["sections"].is_number_unsigned() ||
+       (meta.contains("utf8_repairs") && !meta["utf8_repairs"].is_number_unsigned())) {
+        return false;
+    }
+
+    result.topic = meta["topic"];
+    result.sections = meta["sections"];
+    result.repairs = meta.value("utf8_repairs", (size_t)0);
+    return true;
+}
+
+bool ResultCache::get(const std::string& key, const std::string& topic, CachedResult& result) {
+    bool found = false;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+
+        auto entry = index.find(key);
+        if(entry != index.end()) {
+            entries.splice(entries.begin(), entries, entry->second);
+            result = entry->second->second;
+            memoryHits++;
+            found = true;
+        }
+        else if(dir.empty()) {
+            misses++;
+            return false;
+        }
+    }
+
+    if(!found) {
+        std::string file = dir + "/" + key + ".json";
+        std::error_code error;
+
+        CachedResult stored;
+        bool valid = readEntry(file, stored);
+        result = stored;
+        if(!valid || !retopic(result, topic)) {
+            // a corrupt entry is dropped, the document is converted and stored again
+            uint64_t size = std::filesystem::file_size(file, error);
+            bool removed = !error && std::filesystem::remove(file, error);
+
+            std::lock_guard<std::mutex> lock(mutex);
+            if(removed) {
+                diskUsed -= std::min(diskUsed, size);
+            }
+            misses++;
+            return false;
+        }
+
+        // touch the file for least recently used eviction of the disk tier
+        std::filesystem::last_write_time(file, std::filesystem::file_time_type::clock::now(), error);
+
+        std::lock_guard<std::mutex> lock(mutex);
+        putMemory(key, stored);
+        diskHits++;
+        return true;
+    }
+
+    if(!retopic(result, topic)) {
+        std::lock_guard<std::mutex> lock(mutex);
+        misses++;
+        return false;
+    }
+    return true;
+}
+
+void ResultCache::putMemory(const std::string& key, const CachedResult& result) {
+    uint64_t size = key.size() + result.topic.size() + result.line.size();
+    if(size > memoryLimit || index.count(key)) {
+        return;
+    }
+
+    entries.emplace_front(key, result);
+    index[key] = entries.begin();
+    memoryUsed += size;
+
+    while(memoryUsed > memoryLimit) {
+        auto& last = entries.back();
+        memoryUsed -= last.first.size() + last.second.topic.size() + last.second.line.size();
+        index.erase(last.first);
+        entries.pop_back();
+        evictions++;
+    }
+}
+
+void ResultCache::put(const std::string& key, const CachedResult& result) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        putMemory(key, result);
+    }
+
+    if(dir.empty()) {
+        return;
+    }
+
+    // write to a private file first, readers never see partial entries
+    std::string file = dir + "/" + key + ".json";
+    std::string temporary = file + ".tmp." + std::to_string(getpid()) + "." +
+                            std::to_string(std::hash<std::thread::id>()(std::this_thread::get_id()));
+    {
+        nlohmann::json meta{
+                {"topic", result.topic},
+                {"sections", result.sections},
+                {"utf8_repairs", result.repairs}
+        };
+        std::ofstream out(temporary, std::ofstream::trunc);
+        out << meta.dump() << "\n" << result.line << "\n";
+        out.flush();
+
+        // a short write, e.g. on a full disk, must never become a visible entry
+        if(!out) {
+            out.close();
+            std::error_code error;
+            std::filesystem::remove(temporary, error);
+            return;
+        }
+    }
+
+    std::error_code error;
+    uint64_t size = std::filesystem::file_size(temporary, error);
+
+    {
+        // workers converting the same content replace each other's file, only the difference is new usage
+        std::lock_guard<std::mutex> lock(mutex);
+        uint64_t replaced = std::filesystem::file_size(file, error);
+        if(error) {
+            replaced = 0;
+        }
+
+        std::filesystem::rename(temporary, file, error);
+        if(error) {
+            std::filesystem::remove(temporary, error);
+            return;
+        }
+
+        diskUsed = diskUsed - std::min(diskUsed, replaced) + size;
+        if(diskUsed <= diskLimit) {
+            return;
+        }
+    }
+    trimDisk();
+}
+
+void ResultCache::trimDisk() {
+    std::error_code error;
+    std::vector<std::pair<std::filesystem::file_time_type, std::filesystem::path>> files;
+    uint64_t used = 0;
+
+    for(auto& entry: std::filesystem::recursive_directory_iterator(root, error)) {
+        if(entry.path().extension() == ".json") {
+            files.emplace_back(entry.last_write_time(error), entry.path());
+            used += entry.file_size(error);
+        }
+    }
+
+    // evict down to 90% of the limit, so the next inserts do not rescan the directory
+    std::sort(files.begin(), files.end());
+    for(size_t i = 0; i < files.size() && used > diskLimit / 10 * 9; i++) {
+        uint64_t size = std::filesystem::file_size(files[i].second, error);
+        if(std::filesystem::remove(files[i].second, error)) {
+            used -= size;
+            std::lock_guard<std::mutex> lock(mutex);
+            evictions++;
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    diskUsed = used;
+}
+
+nlohmann::json ResultCache::metrics() {
+    std::lock_guard<std::mutex> lock(mutex);
+    size_t lookups = memoryHits + diskHits + misses;
+
+    return {
+            {"memory_hits", memoryHits},
+            {"disk_hits", diskHits},
+            {"misses", misses},
+            {"hit_rate", lookups > 0 ? (double)(memoryHits + diskHits) / (double)lookups : 0.0},
+            {"evictions", evictions},
+            {"memory_bytes", memoryUsed},
+            {"disk_bytes", diskUsed}
+    };
+}
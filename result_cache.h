@@ -0,0 +1,101 @@
+#ifndef PDF2TEXT_RESULT_CACHE_H
+#define PDF2TEXT_RESULT_CACHE_H
+
+#include <cstdint>
+#include <list>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "include/nlohmann/json.hpp"
+
+/***
+ * Serialized output of a converted document
+ */
+struct CachedResult {
+    // topic the line was serialized with
+    std::string topic;
+    std::string line;
+    size_t sections = 0;
+    // invalid UTF-8 sequences replaced in the document
+    size_t repairs = 0;
+};
+
+/***
+ * LRU cache of serialized outputs keyed by content hash and conversion options, in memory with an optional
+ * on-disk tier shared between runs
+ */
+class ResultCache {
+public:
+    /***
+     * Create the cache, the on-disk tier keeps the entries of each set of options in its own subdirectory
+     * @param options fingerprint of all options that change the output
+     * @param memoryLimit bytes kept in memory
+     * @param dir directory of the on-disk tier, empty to disable it
+     * @param diskLimit bytes kept on disk over all subdirectories
+     */
+    ResultCache(const std::string& options, uint64_t memoryLimit, const std::string& dir, uint64_t diskLimit);
+
+    /***
+     * Get the cache key of a PDF
+     * @param data PDF content
+     * @return key of the content under the current options
+     */
+    std::string key(const std::vector<char>& data) const;
+
+    /***
+     * Look up a converted document, promoting disk hits into memory
+     * @param key cache key
+     * @param result cached output with the topic rewritten if it differs
+     * @param topic topic of the requested input
+     * @return true on a hit
+     */
+    bool get(const std::string& key, const std::string& topic, CachedResult& result);
+
+    /***
+     * Store the output of a converted document
+     * @param key cache key
+     * @param result serialized output
+     */
+    void put(const std::string& key, const CachedResult& result);
+
+    /***
+     * Get hit and miss counters for the metrics report
+     * @return metrics as JSON object
+     */
+    nlohmann::json metrics();
+
+private:
+    /***
+     * Insert into the memory tier and evict least recently used entries over the limit
+     * @param key cache key
+     * @param result serialized output
+     */
+    void putMemory(const std::string& key, const CachedResult& result);
+
+    /***
+     * Remove the least recently used files of all options until the on-disk tier fits into its limit
+     */
+    void trimDisk();
+
+    uint64_t optionsHash;
+
+    std::mutex mutex;
+    std::list<std::pair<std::string, CachedResult>> entries;
+    std::unordered_map<std::string, std::list<std::pair<std::string, CachedResult>>::iterator> index;
+    uint64_t memoryLimit;
+    uint64_t memoryUsed = 0;
+
+    std::string root;
+    // subdirectory of the root for the current options
+    std::string dir;
+    uint64_t diskLimit;
+    uint64_t diskUsed = 0;
+
+    size_t memoryHits = 0;
+    size_t diskHits = 0;
+    size_t misses = 0;
+    size_t evictions = 0;
+};
+
+#endif //PDF2TEXT_RESULT_CACHE_H
@@ -0,0 +1,145 @@
+#include "scheduler.h"
+
+#include <algorithm>
+
+// extra pages charged to bulk tasks, aging lets them overtake interactive tasks after a bounded wait
+static const double bulkPenalty = 1000;
+
+Scheduler::Scheduler(size_t nodes, size_t capacity, double agingRate)
+        : queues(std::max<size_t>(nodes, 1)), capacity(std::max<size_t>(capacity, 1)), agingRate(agingRate) {
+}
+
+double Scheduler::cost(const Task& task, std::chrono::steady_clock::time_point now) const {
+    double waited = std::chrono::duration<double>(now - task.submitted).count();
+    return (double)task.pages + (task.input.interactive ? 0 : bulkPenalty) - agingRate * waited;
+}
+
+bool Scheduler::select(size_t node, std::chrono::steady_clock::time_point now, size_t& queue, size_t& index) const {
+    bool found = false;
+    double bestCost = 0;
+
+    // the cheapest local task, or the cheapest interactive task of any node if that is cheaper still, so a worker
+    // preempted for an interactive task on another node actually runs it next
+    for(size_t i = 0; i < queues.size(); i++) {
+        size_t q = (node + i) % queues.size();
+        for(size_t t = 0; t < queues[q].size(); t++) {
+            const Task& task = queues[q][t];
+            if(i > 0 && !task.input.interactive) {
+                continue;
+            }
+
+            double taskCost = cost(task, now);
+            if(!found || taskCost < bestCost) {
+                found = true;
+                bestCost = taskCost;
+                queue = q;
+                index = t;
+            }
+        }
+    }
+    if(found) {
+        return true;
+    }
+
+    // steal the cheapest bulk task of the next node only when idle
+    for(size_t i = 1; i < queues.size(); i++) {
+        size_t q = (node + i) % queues.size();
+        for(size_t t = 0; t < queues[q].size(); t++) {
+            double taskCost = cost(queues[q][t], now);
+            if(!found || taskCost < bestCost) {
+                found = true;
+                bestCost = taskCost;
+                queue = q;
+                index = t;
+            }
+        }
+        if(found) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void Scheduler::push(Task task) {
+    {
+        std::unique_lock<CountingMutex> lock(mutex);
+        space.wait(lock, [&]() { return waiting < capacity; });
+
+        task.submitted = std::chrono::steady_clock::now();
+        waiting++;
+        waitingInteractive += task.input.interactive;
+
+        // deal new documents round-robin to the nodes
+        queues[nextNode++ % queues.size()].push_back(std::move(task));
+    }
+    available.notify_one();
+}
+
+void Scheduler::requeue(Task task, size_t node) {
+    {
+        std::lock_guard<CountingMutex> lock(mutex);
+
+        // preempted tasks keep their submission time, so their age protects them from starving
+        waiting++;
+        waitingInteractive += task.input.interactive;
+        queues[node % queues.size()].push_back(std::move(task));
+    }
+    available.notify_one();
+}
+
+bool Scheduler::pop(Task& task, size_t node) {
+    std::unique_lock<CountingMutex> lock(mutex);
+
+    idleWorkers++;
+    available.wait(lock, [&]() { return closed || waiting > 0; });
+    idleWorkers--;
+
+    if(waiting == 0) {
+        return false;
+    }
+
+    size_t q = 0, best = 0;
+    select(node % queues.size(), std::chrono::steady_clock::now(), q, best);
+
+    std::vector<Task>& queue = queues[q];
+    task = std::move(queue[best]);
+    queue[best] = std::move(queue.back());
+    queue.pop_back();
+
+    waiting--;
+    waitingInteractive -= task.input.interactive;
+    lock.unlock();
+
+    space.notify_one();
+    return true;
+}
+
+void Scheduler::close() {
+    {
+        std::lock_guard<CountingMutex> lock(mutex);
+        closed = true;
+    }
+    available.notify_all();
+}
+
+bool Scheduler::shouldPreempt(const Task& running, size_t node) {
+    if(running.input.interactive) {
+        return false;
+    }
+
+    std::lock_guard<CountingMutex> lock(mutex);
+    if(waitingInteractive <= idleWorkers) {
+        return false;
+    }
+
+    // only yield to an interactive task the next pop takes, and an aged bulk task keeps running, otherwise it
+    // would be preempted again right after resuming
+    auto now = std::chrono::steady_clock::now();
+    size_t q = 0, index = 0;
+    if(!select(node % queues.size(), now, q, index)) {
+        return false;
+    }
+
+    const Task& next = queues[q][index];
+    return next.input.interactive && cost(next, now) < cost(running, now);
+}
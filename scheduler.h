@@ -0,0 +1,109 @@
+#ifndef PDF2TEXT_SCHEDULER_H
+#define PDF2TEXT_SCHEDULER_H
+
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include "converter.h"
+#include "input.h"
+#include "lock_stats.h"
+
+/***
+ * A document waiting for a worker, either new or preempted at a page boundary
+ */
+struct Task {
+    Input input;
+    // in-memory PDF content of archive members
+    std::shared_ptr<std::vector<char>> data;
+    // expected remaining pages
+    size_t pages = 0;
+    std::chrono::steady_clock::time_point submitted;
+    // started conversion of a preempted document
+    std::unique_ptr<Conversion> conversion;
+    // result cache key, empty if the cache is disabled
+    std::string cacheKey;
+};
+
+/***
+ * Task queue with priority classes and shortest-expected-job-first order, aged to prevent starvation
+ */
+class Scheduler {
+public:
+    /***
+     * Create an empty scheduler
+     * @param nodes number of queues, one per NUMA node
+     * @param capacity number of new tasks that may wait, preempted tasks are always accepted
+     * @param agingRate pages a waiting task gains per second of waiting
+     */
+    Scheduler(size_t nodes, size_t capacity, double agingRate);
+
+    /***
+     * Add a new task, waits while the scheduler is full
+     * @param task new task
+     */
+    void push(Task task);
+
+    /***
+     * Put a preempted task back into the queue of its node
+     * @param task preempted task
+     * @param node NUMA node of the worker
+     */
+    void requeue(Task task, size_t node);
+
+    /***
+     * Take the task with the lowest cost, local tasks first unless an interactive task elsewhere is cheaper
+     * @param task next task
+     * @param node NUMA node of the worker
+     * @return false if the scheduler is closed and empty
+     */
+    bool pop(Task& task, size_t node);
+
+    /***
+     * Signal that no more new tasks will be pushed
+     */
+    void close();
+
+    /***
+     * Check if a running bulk task should yield to a cheaper interactive task that no idle worker can take
+     * @param running task of the calling worker
+     * @param node NUMA node of the worker, the preempted task is requeued there
+     * @return true if the next pop of the worker would take a waiting interactive task
+     */
+    bool shouldPreempt(const Task& running, size_t node);
+
+private:
+    /***
+     * Get the scheduling cost of a task, lower runs first
+     * @param task waiting task
+     * @param now current time
+     * @return expected pages plus class penalty minus aging bonus
+     */
+    double cost(const Task& task, std::chrono::steady_clock::time_point now) const;
+
+    /***
+     * Find the task that pop takes for a worker
+     * @param node NUMA node of the worker
+     * @param now current time
+     * @param queue queue of the task
+     * @param index position of the task in its queue
+     * @return false if all queues are empty
+     */
+    bool select(size_t node, std::chrono::steady_clock::time_point now, size_t& queue, size_t& index) const;
+
+    std::vector<std::vector<Task>> queues;
+    size_t capacity;
+    double agingRate;
+
+    CountingMutex mutex{"scheduler"};
+    std::condition_variable_any available, space;
+    bool closed = false;
+
+    size_t waiting = 0;
+    size_t waitingInteractive = 0;
+    size_t idleWorkers = 0;
+    size_t nextNode = 0;
+};
+
+#endif //PDF2TEXT_SCHEDULER_H
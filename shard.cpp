@@ -0,0 +1,55 @@
+#include "shard.h"
+
+#include <algorithm>
+#include <cstdio>
+#include "converter.h"
+#include "hash.h"
+
+bool parseShard(const std::string& text, Shard& shard) {
+    unsigned long index, count;
+    char rest;
+
+    if(std::sscanf(text.c_str(), "%lu/%lu%c", &index, &count, &rest) != 2 || count == 0 || index == 0 ||
+       index > count) {
+        return false;
+    }
+
+    shard.index = index;
+    shard.count = count;
+    return true;
+}
+
+bool inShard(const Input& input, const Shard& shard) {
+    return fnv1a(input.relative) % shard.count == shard.index - 1;
+}
+
+void printPlan(const std::vector<Input>& inputs, size_t count) {
+    std::vector<size_t> files(count, 0);
+    std::vector<size_t> pages(count, 0);
+    size_t totalPages = 0;
+
+    for(const Input& input: inputs) {
+        expandInput(input, [&](const Input& file, std::vector<char>* data) {
+            size_t pageCount = countPages(file, data);
+
+            size_t shard = fnv1a(file.relative) % count;
+            files[shard]++;
+            pages[shard] += pageCount;
+            totalPages += pageCount;
+        });
+    }
+
+    std::printf("%-12s %10s %10s %8s\n", "shard", "files", "pages", "share");
+
+    size_t maxPages = 0;
+    for(size_t i = 0; i < count; i++) {
+        std::string name = std::to_string(i + 1) + "/" + std::to_string(count);
+        double share = totalPages > 0 ? 100.0 * (double)pages[i] / (double)totalPages : 0.0;
+        std::printf("%-12s %10zu %10zu %7.1f%%\n", name.c_str(), files[i], pages[i], share);
+        maxPages = std::max(maxPages, pages[i]);
+    }
+
+    // the slowest shard determines the run time
+    double mean = (double)totalPages / (double)count;
+    std::printf("imbalance (max/mean pages): %.2f\n", mean > 0 ? (double)maxPages / mean : 0.0);
+}
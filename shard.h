@@ -0,0 +1,41 @@
+#ifndef PDF2TEXT_SHARD_H
+#define PDF2TEXT_SHARD_H
+
+#include <string>
+#include <vector>
+#include "input.h"
+
+/***
+ * Static partition of the inputs for multi-node runs
+ */
+struct Shard {
+    // 1-based shard number
+    size_t index = 1;
+    // total number of shards
+    size_t count = 1;
+};
+
+/***
+ * Parse a shard given as "i/N"
+ * @param text shard description
+ * @param shard parsed shard
+ * @return false if the description is invalid
+ */
+bool parseShard(const std::string& text, Shard& shard);
+
+/***
+ * Check if an input belongs to a shard by a stable hash of its relative path
+ * @param input plain file or archive member
+ * @param shard selected shard
+ * @return true if the shard converts the input
+ */
+bool inShard(const Input& input, const Shard& shard);
+
+/***
+ * Print the number of files and estimated pages of every shard
+ * @param inputs all command line inputs
+ * @param count number of shards
+ */
+void printPlan(const std::vector<Input>& inputs, size_t count);
+
+#endif //PDF2TEXT_SHARD_H
@@ -0,0 +1,193 @@
+#include "sqlite_sink.h"
+
+#include <cstdio>
+#include <iostream>
+#include <sqlite3.h>
+#include "profiler.h"
+
+// documents waiting for the writer thread
+static const size_t queueCapacity = 256;
+// inserted rows per transaction
+static const size_t transactionRows = 50000;
+
+SqliteSink::SqliteSink(const std::string& path, bool fts) : fts(fts) {
+    std::remove(path.c_str());
+    std::remove((path + "-wal").c_str());
+    std::remove((path + "-shm").c_str());
+
+    if(sqlite3_open(path.c_str(), &db) != SQLITE_OK) {
+        std::cout << "Failed to create " << path << ": " << sqlite3_errmsg(db) << std::endl;
+        sqlite3_close(db);
+        db = nullptr;
+        return;
+    }
+
+    // the page size only applies before the first table is created
+    execute("PRAGMA page_size = 16384");
+    execute("PRAGMA journal_mode = WAL");
+    execute("PRAGMA synchronous = NORMAL");
+    execute("PRAGMA cache_size = -65536");
+    execute("PRAGMA temp_store = MEMORY");
+
+    execute("CREATE TABLE documents (id INTEGER PRIMARY KEY, seq INTEGER, path TEXT, member INTEGER, title TEXT, "
+            "topic TEXT, language TEXT, hash TEXT)");
+    execute("CREATE TABLE sections (id INTEGER PRIMARY KEY, document INTEGER REFERENCES documents(id), "
+            "paragraph TEXT, ordinal INTEGER, offset INTEGER, text TEXT, simhash TEXT)");
+
+    sqlite3_prepare_v2(db, "INSERT INTO documents (seq, path, member, title, topic, language, hash) "
+                           "VALUES (?, ?, ?, ?, ?, ?, ?)", -1, &insertDocument, nullptr);
+    sqlite3_prepare_v2(db, "INSERT INTO sections (document, paragraph, ordinal, offset, text, simhash) "
+                           "VALUES (?, ?, ?, ?, ?, ?)", -1, &insertSection, nullptr);
+
+    if(failed || insertDocument == nullptr || insertSection == nullptr) {
+        std::cout << "Failed to create " << path << ": " << sqlite3_errmsg(db) << std::endl;
+        return;
+    }
+
+    writer = std::thread(&SqliteSink::run, this);
+}
+
+SqliteSink::~SqliteSink() {
+    close();
+}
+
+bool SqliteSink::valid() const {
+    return writer.joinable();
+}
+
+void SqliteSink::execute(const char* sql) {
+    char* error = nullptr;
+    if(sqlite3_exec(db, sql, nullptr, nullptr, &error) != SQLITE_OK) {
+        std::cout << "SQLite: " << (error != nullptr ? error : "unknown error") << std::endl;
+        sqlite3_free(error);
+        failed = true;
+    }
+}
+
+void SqliteSink::submit(SqliteDocument document) {
+    std::unique_lock<CountingMutex> lock(mutex);
+    space.wait(lock, [&]() { return queue.size() < queueCapacity || closed; });
+    if(closed) {
+        return;
+    }
+
+    queue.push_back(std::move(document));
+    available.notify_one();
+}
+
+/***
+ * Bind a string to a statement parameter without copying it
+ * @param statement prepared statement
+ * @param index 1-based parameter index
+ * @param text bound text, must live until the statement is reset
+ */
+static void bindText(sqlite3_stmt* statement, int index, const std::string& text) {
+    sqlite3_bind_text(statement, index, text.data(), (int)text.size(), SQLITE_STATIC);
+}
+
+void SqliteSink::insert(const SqliteDocument& document) {
+    sqlite3_bind_int64(insertDocument, 1, (sqlite3_int64)document.input.seq);
+    bindText(insertDocument, 2, document.input.path);
+    sqlite3_bind_int64(insertDocument, 3, (sqlite3_int64)document.input.member);
+    bindText(insertDocument, 4, document.title);
+    bindText(insertDocument, 5, document.input.topic);
+    bindText(insertDocument, 6, document.language);
+    bindText(insertDocument, 7, document.hash);
+
+    if(sqlite3_step(insertDocument) != SQLITE_DONE) {
+        failed = true;
+    }
+    sqlite3_reset(insertDocument);
+    sqlite3_int64 id = sqlite3_last_insert_rowid(db);
+
+    for(const SqliteSection& section: document.sections) {
+        sqlite3_bind_int64(insertSection, 1, id);
+        bindText(insertSection, 2, section.paragraph);
+        sqlite3_bind_int64(insertSection, 3, (sqlite3_int64)section.ordinal);
+        sqlite3_bind_int64(insertSection, 4, (sqlite3_int64)section.offset);
+        bindText(insertSection, 5, section.text);
+        if(section.simhash.empty()) {
+            sqlite3_bind_null(insertSection, 6);
+        }
+        else {
+            bindText(insertSection, 6, section.simhash);
+        }
+
+        if(sqlite3_step(insertSection) != SQLITE_DONE) {
+            failed = true;
+        }
+        sqlite3_reset(insertSection);
+    }
+}
+
+void SqliteSink::run() {
+    StageScope scope(Stage::Sqlite);
+    size_t rows = 0;
+    bool open = false;
+
+    while(true) {
+        std::deque<SqliteDocument> batch;
+        {
+            std::unique_lock<CountingMutex> lock(mutex);
+            available.wait(lock, [&]() { return !queue.empty() || closed; });
+            if(queue.empty()) {
+                break;
+            }
+            batch.swap(queue);
+            space.notify_all();
+        }
+
+        // one transaction spans many documents, a commit per document would sync the WAL every time
+        for(const SqliteDocument& document: batch) {
+            if(!open) {
+                execute("BEGIN");
+                open = true;
+            }
+
+            insert(document);
+            rows += 1 + document.sections.size();
+
+            if(rows >= transactionRows) {
+                execute("COMMIT");
+                open = false;
+                rows = 0;
+            }
+        }
+    }
+
+    if(open) {
+        execute("COMMIT");
+    }
+}
+
+bool SqliteSink::close() {
+    if(db == nullptr) {
+        return false;
+    }
+
+    {
+        std::lock_guard<CountingMutex> lock(mutex);
+        closed = true;
+    }
+    available.notify_all();
+    space.notify_all();
+    if(writer.joinable()) {
+        writer.join();
+    }
+
+    sqlite3_finalize(insertDocument);
+    sqlite3_finalize(insertSection);
+
+    // indexes are built once at the end, which is faster than maintaining them during the inserts
+    execute("CREATE INDEX sections_document ON sections (document)");
+    if(fts) {
+        execute("CREATE VIRTUAL TABLE sections_fts USING fts5(paragraph, text, content='sections', "
+                "content_rowid='id')");
+        execute("INSERT INTO sections_fts (sections_fts) VALUES ('rebuild')");
+    }
+    execute("PRAGMA wal_checkpoint(TRUNCATE)");
+
+    sqlite3_close(db);
+    db = nullptr;
+    return !failed;
+}
@@ -0,0 +1,103 @@
+#ifndef PDF2TEXT_SQLITE_SINK_H
+#define PDF2TEXT_SQLITE_SINK_H
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "input.h"
+#include "lock_stats.h"
+
+struct sqlite3;
+struct sqlite3_stmt;
+
+/***
+ * Written record of a document in the SQLite output
+ */
+struct SqliteSection {
+    std::string paragraph;
+    size_t ordinal = 0;
+    size_t offset = 0;
+    std::string text;
+    // SimHash as hex string, empty if duplicates are not detected
+    std::string simhash;
+};
+
+/***
+ * Converted document in the SQLite output
+ */
+struct SqliteDocument {
+    Input input;
+    std::string title;
+    std::string language;
+    // content hash as hex string
+    std::string hash;
+    std::vector<SqliteSection> sections;
+};
+
+/***
+ * SQLite output written by a single thread, workers submit converted documents
+ */
+class SqliteSink {
+public:
+    /***
+     * Create the database, an existing file is replaced, and start the writer thread
+     * @param path database file
+     * @param fts true to build an FTS5 table over the section texts when closing
+     */
+    SqliteSink(const std::string& path, bool fts);
+    ~SqliteSink();
+
+    /***
+     * Check if the database was created
+     * @return true if documents can be submitted
+     */
+    bool valid() const;
+
+    /***
+     * Queue a converted document for insertion, waits while the writer is behind
+     * @param document converted document
+     */
+    void submit(SqliteDocument document);
+
+    /***
+     * Insert all queued documents, build the indexes and close the database
+     * @return false if a statement failed
+     */
+    bool close();
+
+private:
+    /***
+     * Insert queued documents in large transactions until the sink is closed
+     */
+    void run();
+
+    /***
+     * Insert a document and its sections
+     * @param document converted document
+     */
+    void insert(const SqliteDocument& document);
+
+    /***
+     * Run a SQL statement without results
+     * @param sql statement
+     */
+    void execute(const char* sql);
+
+    sqlite3* db = nullptr;
+    sqlite3_stmt* insertDocument = nullptr;
+    sqlite3_stmt* insertSection = nullptr;
+    bool fts;
+    bool failed = false;
+
+    CountingMutex mutex{"sqlite_queue"};
+    std::condition_variable_any available, space;
+    std::deque<SqliteDocument> queue;
+    bool closed = false;
+    std::thread writer;
+};
+
+#endif //PDF2TEXT_SQLITE_SINK_H
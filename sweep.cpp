@@ -0,0 +1,195 @@
+#include "sweep.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <thread>
+#include <unordered_map>
+#include "include/nlohmann/json.hpp"
+#include "converter.h"
+#include "pipeline.h"
+#include "scheduler.h"
+#include "text_store.h"
+
+bool parseThresholds(const std::string& text, std::vector<float>& thresholds) {
+    std::stringstream list(text);
+    std::string item;
+
+    while(std::getline(list, item, ',')) {
+        char* end = nullptr;
+        float threshold = std::strtof(item.c_str(), &end);
+        if(item.empty() || *end != '\0' || threshold < 0 || threshold > 1) {
+            return false;
+        }
+        thresholds.push_back(threshold);
+    }
+
+    std::sort(thresholds.begin(), thresholds.end());
+    thresholds.erase(std::unique(thresholds.begin(), thresholds.end()), thresholds.end());
+    return !thresholds.empty();
+}
+
+/***
+ * Get the histogram bucket of a match distance relative to the title length
+ * @param match title match
+ * @param separator section title
+ * @return bucket label with a width of 0.01
+ */
+static std::string distanceBucket(const TitleMatch& match, const std::string& separator) {
+    double relative = separator.empty() ? 0.0 : std::min(1.0, (double)match.dist / (double)separator.size());
+
+    char bucket[8];
+    std::snprintf(bucket, sizeof(bucket), "%.2f", std::floor(relative * 100) / 100);
+    return bucket;
+}
+
+/***
+ * Aggregated results of one threshold
+ */
+struct SweepResult {
+    size_t sections = 0;
+    // documents with at least one section
+    size_t split = 0;
+    // documents with every ToC title found
+    size_t complete = 0;
+    // relative distances of accepted title matches
+    std::map<std::string, size_t> distances;
+};
+
+void runSweep(const std::vector<Input>& inputs, const std::vector<float>& thresholds,
+              const ConversionOptions& options, size_t workers, OutputWriter& writer, const std::string& report) {
+    std::mutex mutex;
+    std::vector<SweepResult> results(thresholds.size());
+    // best relative distance of every searched title, independent of the threshold
+    std::map<std::string, size_t> candidates;
+    nlohmann::json documents = nlohmann::json::array();
+    size_t converted = 0;
+
+    Scheduler scheduler(1, 1024, 0);
+
+    std::vector<std::thread> pool;
+    for(size_t w = 0; w < workers; w++) {
+        pool.emplace_back([&]() {
+            Task task;
+            while(scheduler.pop(task, 0)) {
+                std::unique_ptr<Conversion> conversion = startConversion(task.input, task.data, options, writer,
+                                                                         nullptr);
+                if(conversion == nullptr) {
+                    continue;
+                }
+
+                // extract every page once for all thresholds, pages not being matched may stay compressed
+                TextStore pages(options.compressText);
+                for(int i = 0; i < conversion->pageCount; i++) {
+                    pages.put(i, pageText(*conversion->document, i, false));
+                }
+
+                // the remaining content of a page is always a prefix, so page, prefix length and title identify
+                // a search that is shared by all thresholds which reach the same state
+                std::unordered_map<std::string, TitleMatch> matches;
+                std::map<std::string, size_t> searched;
+                int page = 0;
+                auto find = [&](const std::string& content, const std::string& separator) {
+                    std::string key = std::to_string(page) + ":" + std::to_string(content.size()) + ":" + separator;
+                    auto found = matches.find(key);
+                    if(found == matches.end()) {
+                        found = matches.emplace(key, findTitle(content, separator)).first;
+                        if(found->second.dist != (unsigned int)-1) {
+                            searched[distanceBucket(found->second, separator)]++;
+                        }
+                    }
+                    return found->second;
+                };
+
+                std::vector<size_t> sections(thresholds.size());
+                std::vector<std::map<std::string, size_t>> distances(thresholds.size());
+
+                for(size_t t = 0; t < thresholds.size(); t++) {
+                    std::stack<std::string> titles = conversion->sections;
+                    std::vector<std::string> sectionTexts{""};
+                    std::queue<std::string> usedSections;
+
+                    for(page = conversion->pageCount - 1; page >= 0; page--) {
+                        extractSections(titles, sectionTexts, *pages.find(page), usedSections, thresholds[t],
+                                        [&](const std::string& content, const std::string& separator) {
+                                            TitleMatch match = find(content, separator);
+                                            if(titleMatches(match, separator, thresholds[t])) {
+                                                distances[t][distanceBucket(match, separator)]++;
+                                            }
+                                            return match;
+                                        });
+                    }
+                    sections[t] = usedSections.size();
+                }
+
+                std::lock_guard<std::mutex> lock(mutex);
+                for(auto& bucket: searched) {
+                    candidates[bucket.first] += bucket.second;
+                }
+
+                for(size_t t = 0; t < thresholds.size(); t++) {
+                    results[t].sections += sections[t];
+                    results[t].split += sections[t] > 0;
+                    results[t].complete += sections[t] == conversion->document->titles.size();
+                    for(auto& bucket: distances[t]) {
+                        results[t].distances[bucket.first] += bucket.second;
+                    }
+                }
+
+                documents.push_back({
+                        {"file", task.input.path},
+                        {"titles", conversion->document->titles.size()},
+                        {"sections", sections}
+                });
+                converted++;
+            }
+        });
+    }
+
+    for(const Input& input: inputs) {
+        bool complete = expandInput(input, [&](const Input& file, std::vector<char>* data) {
+            Task task;
+            task.input = file;
+            task.data = data != nullptr ? std::make_shared<std::vector<char>>(std::move(*data)) : nullptr;
+            scheduler.push(std::move(task));
+        }, [&](const Input& file, const std::string& reason) {
+            writer.skip(file, reason);
+        });
+
+        if(!complete) {
+            writer.skip(input, "unreadable archive");
+        }
+    }
+
+    scheduler.close();
+
+    for(std::thread& worker: pool) {
+        worker.join();
+    }
+
+    nlohmann::json summary = nlohmann::json::array();
+    for(size_t t = 0; t < thresholds.size(); t++) {
+        summary.push_back({
+                {"threshold", thresholds[t]},
+                {"sections", results[t].sections},
+                {"documents_split", results[t].split},
+                {"documents_complete", results[t].complete},
+                {"match_distances", results[t].distances}
+        });
+    }
+
+    nlohmann::json json{
+            {"documents", converted},
+            {"thresholds", summary},
+            {"candidate_distances", candidates},
+            {"per_document", documents}
+    };
+
+    std::ofstream out(report, std::ofstream::trunc);
+    // document paths are file names, a single invalid one must not lose the report at the end of the sweep
+    out << json.dump(2, ' ', false, nlohmann::json::error_handler_t::replace) << std::endl;
+}
@@ -0,0 +1,31 @@
+#ifndef PDF2TEXT_SWEEP_H
+#define PDF2TEXT_SWEEP_H
+
+#include <string>
+#include <vector>
+#include "converter.h"
+#include "input.h"
+#include "output.h"
+
+/***
+ * Parse a comma separated list of similarity thresholds
+ * @param text threshold list, e.g. "0.05,0.1,0.15"
+ * @param thresholds parsed thresholds in ascending order
+ * @return false if the list is empty or contains a value outside of [0, 1]
+ */
+bool parseThresholds(const std::string& text, std::vector<float>& thresholds);
+
+/***
+ * Split all inputs with every threshold from one text extraction and one title search per page and title,
+ * and write a comparison report
+ * @param inputs inputs to convert
+ * @param thresholds compared thresholds
+ * @param options conversion options, the threshold is ignored
+ * @param workers number of worker threads
+ * @param writer output for skipped files
+ * @param report path of the JSON report
+ */
+void runSweep(const std::vector<Input>& inputs, const std::vector<float>& thresholds,
+              const ConversionOptions& options, size_t workers, OutputWriter& writer, const std::string& report);
+
+#endif //PDF2TEXT_SWEEP_H
@@ -0,0 +1,107 @@
+#include "synthetic.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <vector>
+
+static const char* const words[] = {
+        "system", "value", "control", "device", "signal", "output", "module", "install", "check", "power",
+        "service", "manual", "safety", "operate", "switch", "cable", "connect", "display", "error", "reset",
+        "filter", "pressure", "sensor", "voltage", "current", "mode", "option", "select", "press", "level"
+};
+
+std::string syntheticPdf(const SyntheticDocument& document) {
+    uint64_t state = document.seed * 0x9e3779b97f4a7c15ull + 1;
+    auto random = [&]() {
+        // xorshift64, reproducible across platforms
+        state ^= state << 13;
+        state ^= state >> 7;
+        state ^= state << 17;
+        return state;
+    };
+
+    int pages = std::max(document.pages, 1);
+    int sections = std::clamp(document.sections, 1, pages);
+
+    std::vector<std::string> titles;
+    std::vector<int> sectionPages;
+    for(int s = 0; s < sections; s++) {
+        titles.push_back(std::to_string(s + 1) + " " + words[random() % 30] + " " + words[random() % 30]);
+        sectionPages.push_back(s * pages / sections);
+    }
+
+    std::vector<std::string> objects;
+
+    // 1 catalog, 2 page tree, 3 outline root, 4 font, then outline items, then page and content pairs
+    int firstItem = 5;
+    int firstPage = firstItem + sections;
+    objects.push_back("<< /Type /Catalog /Pages 2 0 R /Outlines 3 0 R /PageMode /UseOutlines >>");
+
+    std::string kids;
+    for(int p = 0; p < pages; p++) {
+        kids += std::to_string(firstPage + 2 * p) + " 0 R ";
+    }
+    objects.push_back("<< /Type /Pages /Kids [" + kids + "] /Count " + std::to_string(pages) + " >>");
+    objects.push_back("<< /Type /Outlines /First " + std::to_string(firstItem) + " 0 R /Last " +
+                      std::to_string(firstItem + sections - 1) + " 0 R /Count " + std::to_string(sections) + " >>");
+    objects.push_back("<< /Type /Font /Subtype /Type1 /BaseFont /Helvetica /Encoding /WinAnsiEncoding >>");
+
+    for(int s = 0; s < sections; s++) {
+        std::string item = "<< /Title (" + titles[s] + ") /Parent 3 0 R /Dest [" +
+                           std::to_string(firstPage + 2 * sectionPages[s]) + " 0 R /XYZ null null null]";
+        if(s > 0) {
+            item += " /Prev " + std::to_string(firstItem + s - 1) + " 0 R";
+        }
+        if(s + 1 < sections) {
+            item += " /Next " + std::to_string(firstItem + s + 1) + " 0 R";
+        }
+        objects.push_back(item + " >>");
+    }
+
+    int section = 0;
+    for(int p = 0; p < pages; p++) {
+        std::string content = "BT /F1 9 Tf 11 TL 40 800 Td\n";
+        for(int l = 0; l < document.lines; l++) {
+            // headings start the line after the section begins on this page
+            if(l == 1 && section < sections && sectionPages[section] == p) {
+                content += "(" + titles[section++] + ") '\n";
+                continue;
+            }
+
+            std::string line;
+            int count = 8 + (int)(random() % 6);
+            for(int w = 0; w < count; w++) {
+                line += (w > 0 ? " " : "") + std::string(words[random() % 30]);
+            }
+            content += "(" + line + (random() % 5 == 0 ? "." : "") + ") '\n";
+        }
+        content += "ET";
+
+        objects.push_back("<< /Type /Page /Parent 2 0 R /MediaBox [0 0 595 842] /Resources << /Font << /F1 4 0 R >> "
+                          ">> /Contents " + std::to_string(firstPage + 2 * p + 1) + " 0 R >>");
+        objects.push_back("<< /Length " + std::to_string(content.size()) + " >>\nstream\n" + content +
+                          "\nendstream");
+    }
+
+    // document information with the title
+    objects.push_back("<< /Title (Synthetic manual " + std::to_string(document.seed) + ") >>");
+
+    std::string pdf = "%PDF-1.4\n";
+    std::vector<size_t> offsets;
+    for(size_t i = 0; i < objects.size(); i++) {
+        offsets.push_back(pdf.size());
+        pdf += std::to_string(i + 1) + " 0 obj\n" + objects[i] + "\nendobj\n";
+    }
+
+    size_t xref = pdf.size();
+    pdf += "xref\n0 " + std::to_string(objects.size() + 1) + "\n0000000000 65535 f \n";
+    for(size_t offset: offsets) {
+        char entry[24];
+        std::snprintf(entry, sizeof(entry), "%010zu 00000 n \n", offset);
+        pdf += entry;
+    }
+
+    pdf += "trailer\n<< /Size " + std::to_string(objects.size() + 1) + " /Root 1 0 R /Info " +
+           std::to_string(objects.size()) + " 0 R >>\nstartxref\n" + std::to_string(xref) + "\n%%EOF\n";
+    return pdf;
+}
@@ -0,0 +1,25 @@
+#ifndef PDF2TEXT_SYNTHETIC_H
+#define PDF2TEXT_SYNTHETIC_H
+
+#include <cstdint>
+#include <string>
+
+/***
+ * Shape of a generated PDF
+ */
+struct SyntheticDocument {
+    int pages = 40;
+    int sections = 12;
+    // text lines per page
+    int lines = 50;
+    uint64_t seed = 1;
+};
+
+/***
+ * Generate a PDF with a table of contents whose titles appear as headings in the page text
+ * @param document shape of the PDF
+ * @return PDF file content
+ */
+std::string syntheticPdf(const SyntheticDocument& document);
+
+#endif //PDF2TEXT_SYNTHETIC_H
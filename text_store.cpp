@@ -0,0 +1,115 @@
+#include "text_store.h"
+
+#include <iterator>
+#include "lz.h"
+
+// texts below this size do not gain from compression
+static const size_t minCompressedSize = 256;
+
+TextStore::TextStore(bool compress, size_t hotBuffers) : compress(compress), hotBuffers(hotBuffers) {
+}
+
+void TextStore::put(int key, std::string text) {
+    Entry entry;
+    entry.size = text.size();
+
+    if(compress && text.size() >= minCompressedSize) {
+        std::string block = lzCompress(text);
+        if(block.size() < text.size()) {
+            entry.data = std::move(block);
+            entry.compressed = true;
+        }
+    }
+    if(!entry.compressed) {
+        entry.data = std::move(text);
+    }
+
+    auto found = entries.find(key);
+    if(found != entries.end()) {
+        used -= found->second.data.size();
+    }
+    for(auto buffer = hot.begin(); buffer != hot.end(); buffer++) {
+        if(buffer->first == key) {
+            used -= buffer->second.size();
+            hot.erase(buffer);
+            break;
+        }
+    }
+
+    used += entry.data.size();
+    entries[key] = std::move(entry);
+}
+
+const std::string* TextStore::find(int key) {
+    auto found = entries.find(key);
+    if(found == entries.end()) {
+        return nullptr;
+    }
+    if(!found->second.compressed) {
+        return &found->second.data;
+    }
+
+    for(auto buffer = hot.begin(); buffer != hot.end(); buffer++) {
+        if(buffer->first == key) {
+            hot.splice(hot.begin(), hot, buffer);
+            return &hot.front().second;
+        }
+    }
+
+    // reuse the least recently used buffer and its capacity
+    if(hot.size() >= hotBuffers && !hot.empty()) {
+        hot.splice(hot.begin(), hot, std::prev(hot.end()));
+        used -= hot.front().second.size();
+    }
+    else {
+        hot.emplace_front();
+    }
+
+    hot.front().first = key;
+    if(!lzDecompress(found->second.data, found->second.size, hot.front().second)) {
+        hot.pop_front();
+        return nullptr;
+    }
+    used += hot.front().second.size();
+    return &hot.front().second;
+}
+
+bool TextStore::take(int key, std::string& text) {
+    auto found = entries.find(key);
+    if(found == entries.end()) {
+        return false;
+    }
+
+    bool ok = true;
+    if(found->second.compressed) {
+        ok = lzDecompress(found->second.data, found->second.size, text);
+    }
+    else {
+        text = std::move(found->second.data);
+    }
+
+    used -= found->second.compressed ? found->second.data.size() : found->second.size;
+    for(auto buffer = hot.begin(); buffer != hot.end(); buffer++) {
+        if(buffer->first == key) {
+            used -= buffer->second.size();
+            hot.erase(buffer);
+            break;
+        }
+    }
+    entries.erase(found);
+    return ok;
+}
+
+void TextStore::clear() {
+    entries.clear();
+    hot.clear();
+    used = 0;
+}
+
+size_t TextStore::size() const {
+    return entries.size();
+}
+
+uint64_t TextStore::bytes() const {
+    return used;
+}
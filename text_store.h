@@ -0,0 +1,76 @@
+#ifndef PDF2TEXT_TEXT_STORE_H
+#define PDF2TEXT_TEXT_STORE_H
+
+#include <cstdint>
+#include <list>
+#include <string>
+#include <unordered_map>
+
+/***
+ * Texts by number, optionally kept LZ4 compressed and decompressed on demand into a small pool of hot buffers
+ */
+class TextStore {
+public:
+    /***
+     * Create an empty store
+     * @param compress true to compress texts that are not in use
+     * @param hotBuffers number of decompressed texts kept
+     */
+    explicit TextStore(bool compress = false, size_t hotBuffers = 4);
+
+    /***
+     * Add or replace a text
+     * @param key text number
+     * @param text text
+     */
+    void put(int key, std::string text);
+
+    /***
+     * Get a text, decompressing it into a hot buffer if needed
+     * @param key text number
+     * @return text valid until the next call of this store, nullptr if the text is missing
+     */
+    const std::string* find(int key);
+
+    /***
+     * Remove a text and return it
+     * @param key text number
+     * @param text removed text
+     * @return false if the text is missing
+     */
+    bool take(int key, std::string& text);
+
+    /***
+     * Remove all texts
+     */
+    void clear();
+
+    /***
+     * Get the number of texts
+     * @return number of texts
+     */
+    size_t size() const;
+
+    /***
+     * Get the memory held by the texts and the hot buffers
+     * @return bytes
+     */
+    uint64_t bytes() const;
+
+private:
+    struct Entry {
+        std::string data;
+        // uncompressed size
+        size_t size = 0;
+        bool compressed = false;
+    };
+
+    bool compress;
+    size_t hotBuffers;
+    std::unordered_map<int, Entry> entries;
+    // most recently decompressed texts first
+    std::list<std::pair<int, std::string>> hot;
+    uint64_t used = 0;
+};
+
+#endif //PDF2TEXT_TEXT_STORE_H
@@ -0,0 +1,153 @@
+#include "topology.h"
+
+#include <algorithm>
+#include <cctype>
+#include <filesystem>
+#include <fstream>
+#include <linux/mempolicy.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+/***
+ * Parse a sysfs CPU list like "0-3,8-11"
+ * @param list CPU list
+ * @return CPU numbers
+ */
+static std::vector<int> parseCpuList(const std::string& list) {
+    std::vector<int> cpus;
+    size_t pos = 0;
+
+    while(pos < list.size()) {
+        size_t end = list.find(',', pos);
+        if(end == std::string::npos) {
+            end = list.size();
+        }
+
+        std::string range = list.substr(pos, end - pos);
+        size_t dash = range.find('-');
+        if(!range.empty()) {
+            int first = std::stoi(range.substr(0, dash));
+            int last = dash != std::string::npos ? std::stoi(range.substr(dash + 1)) : first;
+            for(int cpu = first; cpu <= last; cpu++) {
+                cpus.push_back(cpu);
+            }
+        }
+        pos = end + 1;
+    }
+    return cpus;
+}
+
+/***
+ * Read the first line of a sysfs file
+ * @param path file path
+ * @return first line, empty if unavailable
+ */
+static std::string readSysfs(const std::string& path) {
+    std::ifstream in(path);
+    std::string line;
+    std::getline(in, line);
+    return line;
+}
+
+Topology readTopology() {
+    Topology topology;
+
+    cpu_set_t allowed;
+    CPU_ZERO(&allowed);
+    sched_getaffinity(0, sizeof(allowed), &allowed);
+
+    std::error_code error;
+    for(auto& entry: std::filesystem::directory_iterator("/sys/devices/system/node", error)) {
+        std::string name = entry.path().filename().string();
+        if(name.compare(0, 4, "node") != 0 || name.size() == 4 || !std::isdigit((unsigned char)name[4])) {
+            continue;
+        }
+
+        NumaNode node;
+        node.id = std::stoi(name.substr(4));
+        for(int cpu: parseCpuList(readSysfs(entry.path().string() + "/cpulist"))) {
+            if(cpu < CPU_SETSIZE && CPU_ISSET(cpu, &allowed)) {
+                node.cpus.push_back(cpu);
+            }
+        }
+
+        // nodes without usable CPUs are memory-only or outside the cpuset
+        if(!node.cpus.empty()) {
+            topology.nodes.push_back(node);
+        }
+    }
+
+    std::sort(topology.nodes.begin(), topology.nodes.end(),
+              [](const NumaNode& a, const NumaNode& b) { return a.id < b.id; });
+
+    if(topology.nodes.empty()) {
+        NumaNode node;
+        for(int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+            if(CPU_ISSET(cpu, &allowed)) {
+                node.cpus.push_back(cpu);
+            }
+        }
+        topology.nodes.push_back(node);
+    }
+
+    // collect each L3 cache once through the CPUs sharing it
+    for(const NumaNode& node: topology.nodes) {
+        for(int cpu: node.cpus) {
+            std::string cache = "/sys/devices/system/cpu/cpu" + std::to_string(cpu) + "/cache";
+
+            for(auto& index: std::filesystem::directory_iterator(cache, error)) {
+                std::string dir = index.path().string();
+                if(index.path().filename().string().compare(0, 5, "index") != 0 || readSysfs(dir + "/level") != "3") {
+                    continue;
+                }
+
+                L3Cache l3{readSysfs(dir + "/shared_cpu_list"), readSysfs(dir + "/size")};
+                if(std::none_of(topology.caches.begin(), topology.caches.end(),
+                                [&](const L3Cache& known) { return known.cpus == l3.cpus; })) {
+                    topology.caches.push_back(l3);
+                }
+            }
+        }
+    }
+
+    return topology;
+}
+
+bool pinToNode(const NumaNode& node) {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for(int cpu: node.cpus) {
+        CPU_SET(cpu, &set);
+    }
+
+    if(pthread_setaffinity_np(pthread_self(), sizeof(set), &set) != 0) {
+        return false;
+    }
+
+    // prefer the local node for new pages, falling back to other nodes when it is full
+    unsigned long mask[16] = {};
+    if(node.id < (int)(sizeof(mask) * 8)) {
+        mask[node.id / (8 * sizeof(unsigned long))] |= 1ul << (node.id % (8 * sizeof(unsigned long)));
+        syscall(SYS_set_mempolicy, MPOL_PREFERRED, mask, sizeof(mask) * 8);
+    }
+    return true;
+}
+
+nlohmann::json topologyMetrics(const Topology& topology) {
+    nlohmann::json nodes = nlohmann::json::array();
+    for(const NumaNode& node: topology.nodes) {
+        nodes.push_back({{"node", node.id}, {"cpus", node.cpus}});
+    }
+
+    nlohmann::json caches = nlohmann::json::array();
+    for(const L3Cache& cache: topology.caches) {
+        caches.push_back({{"cpus", cache.cpus}, {"size", cache.size}});
+    }
+
+    return {
+            {"numa_nodes", nodes},
+            {"l3_caches", caches}
+    };
+}
@@ -0,0 +1,52 @@
+#ifndef PDF2TEXT_TOPOLOGY_H
+#define PDF2TEXT_TOPOLOGY_H
+
+#include <string>
+#include <vector>
+#include "include/nlohmann/json.hpp"
+
+/***
+ * NUMA node with the CPUs this process may use
+ */
+struct NumaNode {
+    int id = 0;
+    std::vector<int> cpus;
+};
+
+/***
+ * L3 cache shared by a group of CPUs
+ */
+struct L3Cache {
+    std::string cpus;
+    std::string size;
+};
+
+/***
+ * NUMA nodes and L3 caches of the machine
+ */
+struct Topology {
+    std::vector<NumaNode> nodes;
+    std::vector<L3Cache> caches;
+};
+
+/***
+ * Read the NUMA nodes and L3 caches from sysfs, restricted to the CPU affinity mask
+ * @return topology, a single node with all usable CPUs if sysfs has no NUMA information
+ */
+Topology readTopology();
+
+/***
+ * Bind the calling thread to the CPUs of a NUMA node and prefer allocations from its memory
+ * @param node NUMA node
+ * @return false if the thread could not be pinned
+ */
+bool pinToNode(const NumaNode& node);
+
+/***
+ * Get the topology for the metrics report
+ * @param topology machine topology
+ * @return topology as JSON object
+ */
+nlohmann::json topologyMetrics(const Topology& topology);
+
+#endif //PDF2TEXT_TOPOLOGY_H
@@ -0,0 +1,152 @@
+#include "utf8.h"
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+static std::atomic<uint64_t> repairedDocuments{0};
+static std::atomic<uint64_t> repairedSequences{0};
+
+/***
+ * Skip ASCII bytes, 16 at a time with SSE2 or 8 at a time otherwise
+ * @param data text bytes
+ * @param size text size
+ * @param pos start position
+ * @return position of the first byte >= 0x80, or size
+ */
+static size_t skipASCII(const unsigned char* data, size_t size, size_t pos) {
+#if defined(__SSE2__)
+    // the sign bits of 16 bytes in one mask
+    while(pos + 16 <= size) {
+        int mask = _mm_movemask_epi8(_mm_loadu_si128((const __m128i*)(data + pos)));
+        if(mask != 0) {
+            return pos + __builtin_ctz(mask);
+        }
+        pos += 16;
+    }
+#else
+    while(pos + 8 <= size) {
+        uint64_t word;
+        std::memcpy(&word, data + pos, sizeof(word));
+        if((word & 0x8080808080808080ull) != 0) {
+            break;
+        }
+        pos += 8;
+    }
+#endif
+    while(pos < size && data[pos] < 0x80) {
+        pos++;
+    }
+    return pos;
+}
+
+/***
+ * Check the multi-byte sequence at a position, see table 3-7 of the Unicode standard
+ * @param data text bytes
+ * @param size text size
+ * @param pos position of a byte >= 0x80
+ * @param subpart length of the ill-formed sequence to replace if invalid, at least 1
+ * @return length of the valid sequence, 0 if invalid
+ */
+static size_t sequenceLength(const unsigned char* data, size_t size, size_t pos, size_t& subpart) {
+    unsigned char lead = data[pos];
+    size_t length;
+    // range of the second byte, every later byte is 0x80-0xbf
+    unsigned char low = 0x80;
+    unsigned char high = 0xbf;
+
+    if(lead >= 0xc2 && lead <= 0xdf) {
+        length = 2;
+    }
+    else if(lead >= 0xe0 && lead <= 0xef) {
+        length = 3;
+        // no overlong forms and no surrogates
+        if(lead == 0xe0) {
+            low = 0xa0;
+        }
+        else if(lead == 0xed) {
+            high = 0x9f;
+        }
+    }
+    else if(lead >= 0xf0 && lead <= 0xf4) {
+        length = 4;
+        // no overlong forms and nothing above U+10FFFF
+        if(lead == 0xf0) {
+            low = 0x90;
+        }
+        else if(lead == 0xf4) {
+            high = 0x8f;
+        }
+    }
+    else {
+        // continuation byte without lead, overlong lead 0xc0/0xc1 or lead above 0xf4
+        subpart = 1;
+        return 0;
+    }
+
+    for(size_t k = 1; k < length; k++) {
+        if(pos + k >= size || data[pos + k] < low || data[pos + k] > high) {
+            subpart = k;
+            return 0;
+        }
+        low = 0x80;
+        high = 0xbf;
+    }
+    return length;
+}
+
+size_t repairUTF8(std::string& text) {
+    static const char replacement[] = "\xef\xbf\xbd";
+    const unsigned char* data = (const unsigned char*)text.data();
+    size_t size = text.size();
+
+    // the repaired copy is only built once the first invalid sequence is found
+    std::string repaired;
+    size_t repairs = 0;
+    size_t start = 0;
+
+    for(size_t pos = 0;;) {
+        pos = skipASCII(data, size, pos);
+        if(pos == size) {
+            break;
+        }
+
+        size_t subpart;
+        size_t length = sequenceLength(data, size, pos, subpart);
+        if(length > 0) {
+            pos += length;
+            continue;
+        }
+
+        if(repairs++ == 0) {
+            repaired.reserve(size + size / 16 + 3);
+        }
+        repaired.append(text, start, pos - start);
+        repaired.append(replacement, 3);
+        pos += subpart;
+        start = pos;
+    }
+
+    if(repairs > 0) {
+        repaired.append(text, start, size - start);
+        text.swap(repaired);
+    }
+    return repairs;
+}
+
+void countRepairs(size_t repairs) {
+    if(repairs > 0) {
+        repairedDocuments.fetch_add(1, std::memory_order_relaxed);
+        repairedSequences.fetch_add(repairs, std::memory_order_relaxed);
+    }
+}
+
+nlohmann::json repairMetrics() {
+    return {
+            {"documents", repairedDocuments.load()},
+            {"sequences", repairedSequences.load()}
+    };
+}
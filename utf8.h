@@ -0,0 +1,28 @@
+#ifndef PDF2TEXT_UTF8_H
+#define PDF2TEXT_UTF8_H
+
+#include <cstddef>
+#include <string>
+#include "include/nlohmann/json.hpp"
+
+/***
+ * Replace every ill-formed UTF-8 sequence with U+FFFD, one replacement per maximal subpart as recommended by the
+ * Unicode standard, valid text is checked 16 bytes at a time and left untouched
+ * @param text text of unknown encoding quality, repaired in place
+ * @return number of replaced sequences
+ */
+size_t repairUTF8(std::string& text);
+
+/***
+ * Count the repairs of a written document for the metrics report
+ * @param repairs replaced sequences of the document
+ */
+void countRepairs(size_t repairs);
+
+/***
+ * Get the repair counters for the metrics report
+ * @return repaired documents and sequences as JSON object
+ */
+nlohmann::json repairMetrics();
+
+#endif //PDF2TEXT_UTF8_H